@@ -54,8 +54,7 @@ def search():
         if process.returncode != 0 or error:
             return jsonify({'error': f'Query processor error: {error.decode()}'}), 500
 
-        query_terms = expanded_query.split()
-        results = parse_cpp_output(output, query_terms)
+        results = parse_cpp_output(output)
         processing_time = time.time() - start_time
 
         return jsonify({
@@ -66,9 +65,10 @@ def search():
     except Exception as e:
         return jsonify({'error': f'Error during query processing: {str(e)}'}), 500
 
-def parse_cpp_output(output, query_terms):
+def parse_cpp_output(output):
     results = []
-    lines = output.decode().splitlines()
+    # Split on newlines only; passages may contain other line-separator characters
+    lines = output.decode().split('\n')
     i = 0
     while i < len(lines):
         line = lines[i]
@@ -77,55 +77,38 @@ def parse_cpp_output(output, query_terms):
                 docID_part, score_part = line.split(', ')
                 docID = int(docID_part.split(': ')[1])
                 score = float(score_part.split(': ')[1])
-                i += 1
-                if i < len(lines):
-                    passage_line = lines[i]
-                    if passage_line.startswith("Passage:"):
-                        passage = passage_line[len("Passage: "):]
-                        # Shorten the passage based on query terms
-                        passage = shorten_passage(passage, query_terms)
-                    else:
-                        passage = ""
-                else:
-                    passage = ""
-                results.append({'docID': docID, 'score': score, 'snippet': passage})
+                snippet = ""
+                highlights = []
+                if i + 1 < len(lines) and lines[i + 1].startswith("Snippet:"):
+                    i += 1
+                    snippet = lines[i][len("Snippet: "):]
+                if i + 1 < len(lines) and lines[i + 1].startswith("Highlights:"):
+                    i += 1
+                    highlights = parse_highlights(lines[i][len("Highlights:"):], snippet)
+                results.append({'docID': docID, 'score': score, 'snippet': snippet, 'highlights': highlights})
             except ValueError as e:
                 print(f"Error parsing line: {line} -> {e}")
         i += 1
     return results
 
-def shorten_passage(passage, query_terms, window=5):
+def utf16_length(text):
+    """Length of text in UTF-16 code units, the unit JavaScript strings are indexed in."""
+    return len(text.encode('utf-16-le')) // 2
+
+def parse_highlights(field, snippet):
     """
-    Shorten the passage by keeping only `window` words before and after each query term.
-    Replace the rest with '...'.
+    Convert the query processor's "start:length" byte ranges into [start, length]
+    ranges of the decoded snippet, counted in UTF-16 code units so the frontend can
+    slice the snippet with them directly.
     """
-    words = passage.split()
-    relevant_indices = set()
-
-    # Find the indices of query terms in the passage
-    for idx, word in enumerate(words):
-        for query_term in query_terms:
-            if query_term.lower() in word.lower():  # Case-insensitive match
-                # Add indices for a window around the query term
-                relevant_indices.update(range(max(0, idx - window), min(len(words), idx + window + 1)))
-
-    # Create a new passage with only relevant words and '...' for skipped parts
-    shortened = []
-    in_relevant_section = False
-
-    for idx, word in enumerate(words):
-        if idx in relevant_indices:
-            if not in_relevant_section and shortened:
-                shortened.append('...')
-            shortened.append(word)
-            in_relevant_section = True
-        else:
-            in_relevant_section = False
-
-    if shortened[-1] != '...':  # Avoid trailing '...' if the last word is relevant
-        shortened.append('...')
-
-    return ' '.join(shortened)
+    snippet_bytes = snippet.encode()
+    highlights = []
+    for item in field.split():
+        start, length = (int(x) for x in item.split(':'))
+        unit_start = utf16_length(snippet_bytes[:start].decode(errors='ignore'))
+        unit_length = utf16_length(snippet_bytes[start:start + length].decode(errors='ignore'))
+        highlights.append([unit_start, unit_length])
+    return highlights
 
 if __name__ == '__main__':
     print("Starting Flask server...")
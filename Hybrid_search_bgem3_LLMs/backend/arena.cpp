@@ -0,0 +1,86 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+// Arena implementation
+Arena::Arena(size_t chunkSize) : chunkSize(chunkSize), currentChunk(0), used(0) {
+}
+
+char* Arena::allocate(size_t size) {
+    // Move on to the next chunk (reusing it if one exists) when this one is full
+    while (currentChunk < chunks.size() && used + size > chunks[currentChunk].size) {
+        currentChunk++;
+        used = 0;
+    }
+    if (currentChunk == chunks.size()) {
+        Chunk chunk;
+        chunk.size = std::max(chunkSize, size);
+        chunk.data.reset(new char[chunk.size]);
+        chunks.push_back(std::move(chunk));
+        used = 0;
+    }
+    char* result = chunks[currentChunk].data.get() + used;
+    used += size;
+    return result;
+}
+
+std::string_view Arena::copy(std::string_view text) {
+    char* destination = allocate(text.size());
+    std::memcpy(destination, text.data(), text.size());
+    return std::string_view(destination, text.size());
+}
+
+void Arena::reset() {
+    currentChunk = 0;
+    used = 0;
+}
+
+// TermCountMap implementation
+TermCountMap::TermCountMap(Arena& arena) : arena(arena), slots(64, EMPTY_SLOT), mask(63) {
+}
+
+void TermCountMap::add(std::string_view term) {
+    size_t hash = std::hash<std::string_view>()(term);
+    size_t slot = hash & mask;
+    while (slots[slot] != EMPTY_SLOT) {
+        Entry& entry = entryList[slots[slot]];
+        if (hashes[slots[slot]] == hash && entry.term == term) {
+            entry.count++;
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    slots[slot] = static_cast<std::int32_t>(entryList.size());
+    entryList.push_back({ arena.copy(term), 1, static_cast<std::uint32_t>(slot) });
+    hashes.push_back(hash);
+
+    // Keep the load factor at or below one half
+    if (entryList.size() * 2 > slots.size()) {
+        grow();
+    }
+}
+
+void TermCountMap::clear() {
+    // Only the occupied slots are reset, so a large table stays cheap to clear
+    for (const Entry& entry : entryList) {
+        slots[entry.slot] = EMPTY_SLOT;
+    }
+    entryList.clear();
+    hashes.clear();
+    arena.reset();
+}
+
+void TermCountMap::grow() {
+    slots.assign(slots.size() * 2, EMPTY_SLOT);
+    mask = slots.size() - 1;
+    for (size_t i = 0; i < entryList.size(); ++i) {
+        size_t slot = hashes[i] & mask;
+        while (slots[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = static_cast<std::int32_t>(i);
+        entryList[i].slot = static_cast<std::uint32_t>(slot);
+    }
+}
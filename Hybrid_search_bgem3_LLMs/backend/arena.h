@@ -0,0 +1,65 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Bump allocator for short-lived strings. Memory is handed out from large chunks and
+// reset() makes all of it reusable without returning anything to the heap.
+class Arena {
+public:
+    explicit Arena(size_t chunkSize = 64 * 1024);
+
+    char* allocate(size_t size);
+    std::string_view copy(std::string_view text);
+    void reset();
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    size_t chunkSize;
+    std::vector<Chunk> chunks;
+    size_t currentChunk;
+    size_t used;
+};
+
+// Open-addressing hash map from term to count, for counting the terms of one document.
+// Keys are copied into an arena; clear() empties the map and resets the arena while
+// keeping the slot table, entry vector and arena chunks for the next document.
+class TermCountMap {
+public:
+    struct Entry {
+        std::string_view term;
+        int count;
+        std::uint32_t slot;
+    };
+
+    explicit TermCountMap(Arena& arena);
+
+    void add(std::string_view term);
+    void clear();
+
+    // Distinct terms in first-seen order
+    const std::vector<Entry>& entries() const { return entryList; }
+    size_t size() const { return entryList.size(); }
+
+private:
+    static constexpr std::int32_t EMPTY_SLOT = -1;
+
+    Arena& arena;
+    std::vector<Entry> entryList;
+    std::vector<std::int32_t> slots; // Index into entryList, or EMPTY_SLOT
+    std::vector<std::size_t> hashes; // Hash of each entry, kept for rehashing
+    size_t mask;
+
+    void grow();
+};
+
+#endif // ARENA_H
@@ -0,0 +1,296 @@
+#include "net.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
+#include <thread>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+
+// Scatter-gather front end for query_processor servers. Each server holds one shard
+// (query_processor --serve=PORT --shard=N); the broker collects the global statistics
+// for the query from every shard, sends them with the query, and merges the per-shard
+// top-k lists. A shard that does not answer within the timeout is left out, so the
+// broker returns partial results instead of waiting on the slowest server. Results in the
+// same near-duplicate cluster are collapsed to the best-ranked one across shards.
+
+struct ShardEndpoint {
+    std::string host;
+    int port;
+};
+
+// Outcome of one request to one shard
+struct ShardReply {
+    bool ok = false;
+    std::string error;
+    std::vector<std::string> lines;   // Response lines without the final END
+    double latencyMs = 0.0;
+};
+
+struct Result {
+    int docID;
+    double score;
+    std::string snippet;
+    std::string highlights;
+    std::string cluster;   // Near-duplicate cluster; empty when the result has none
+};
+
+// Same rank order as the query processor: higher scores first, then lower docIDs
+bool rankBefore(const Result& a, const Result& b) {
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    return a.docID < b.docID;
+}
+
+// Send one request and read the response up to its END line before the deadline
+ShardReply exchange(const ShardEndpoint& endpoint, const std::string& request, Deadline deadline) {
+    ShardReply reply;
+    auto start = std::chrono::steady_clock::now();
+    int fd = connectTo(endpoint.host, endpoint.port, deadline);
+    if (fd < 0) {
+        reply.latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        reply.error = std::chrono::steady_clock::now() >= deadline ? "timed out" : "unreachable";
+        return reply;
+    }
+    std::string buffer, line;
+    bool complete = false;
+    if (sendAll(fd, request + "\n", deadline)) {
+        while (readLine(fd, buffer, line, deadline)) {
+            if (line == "END") {
+                complete = true;
+                break;
+            }
+            reply.lines.push_back(line);
+        }
+    }
+    closeSocket(fd);
+    reply.latencyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (!complete) {
+        reply.error = std::chrono::steady_clock::now() >= deadline ? "timed out" : "connection closed";
+    } else if (!reply.lines.empty() && reply.lines[0].compare(0, 6, "ERROR ") == 0) {
+        reply.error = reply.lines[0].substr(6);
+    } else {
+        reply.ok = true;
+    }
+    return reply;
+}
+
+// Send a request to every shard that is still active, in parallel, each with its own deadline
+std::vector<ShardReply> scatter(const std::vector<ShardEndpoint>& endpoints, const std::vector<bool>& active,
+                                const std::string& request, int timeoutMs) {
+    std::vector<ShardReply> replies(endpoints.size());
+    std::vector<std::thread> workers;
+    Deadline deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (size_t s = 0; s < endpoints.size(); ++s) {
+        if (active[s]) {
+            workers.emplace_back([&, s]() { replies[s] = exchange(endpoints[s], request, deadline); });
+        }
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return replies;
+}
+
+// Parse "host:port[,host:port...]"
+bool parseEndpoints(const std::string& list, std::vector<ShardEndpoint>& endpoints) {
+    std::stringstream listStream(list);
+    std::string item;
+    while (std::getline(listStream, item, ',')) {
+        size_t colon = item.rfind(':');
+        if (colon == std::string::npos || colon == 0) {
+            return false;
+        }
+        int port = std::atoi(item.c_str() + colon + 1);
+        if (port <= 0) {
+            return false;
+        }
+        endpoints.push_back({ item.substr(0, colon), port });
+    }
+    return !endpoints.empty();
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<ShardEndpoint> endpoints;
+    int timeoutMs = 1000;
+    int k = 10;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 9, "--shards=") == 0) {
+            if (!parseEndpoints(arg.substr(9), endpoints)) {
+                std::cerr << "Error: invalid shard list: " << arg.substr(9) << std::endl;
+                return 1;
+            }
+        } else if (arg.compare(0, 13, "--timeout-ms=") == 0) {
+            timeoutMs = std::stoi(arg.substr(13));
+        } else if (arg.compare(0, 4, "--k=") == 0) {
+            k = std::stoi(arg.substr(4));
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (endpoints.empty() || positional.size() != 2 || k <= 0) {
+        std::cerr << "Usage: " << argv[0] << " --shards=host:port[,host:port...] [--timeout-ms=N] [--k=N] query mode" << std::endl;
+        return 1;
+    }
+    const std::string& query = positional[0];
+    bool conjunctive = (positional[1] == "1");
+    // Tabs and newlines separate request fields
+    std::string cleanQuery = query;
+    std::replace(cleanQuery.begin(), cleanQuery.end(), '\t', ' ');
+    std::replace(cleanQuery.begin(), cleanQuery.end(), '\n', ' ');
+
+    std::vector<bool> active(endpoints.size(), true);
+    std::vector<double> latencyMs(endpoints.size(), 0.0);
+    std::vector<std::string> errors(endpoints.size());
+
+    // Phase 1: global collection size and document frequencies
+    std::vector<ShardReply> statsReplies = scatter(endpoints, active, "STATS\t" + cleanQuery, timeoutMs);
+    std::uint64_t totalDocuments = 0;
+    std::uint64_t totalDocumentLength = 0;
+    std::vector<long long> docFrequencies;
+    bool anyResponded = false;
+    for (size_t s = 0; s < endpoints.size(); ++s) {
+        latencyMs[s] = statsReplies[s].latencyMs;
+        std::istringstream statsStream(statsReplies[s].ok && !statsReplies[s].lines.empty() ? statsReplies[s].lines[0] : "");
+        std::string tag;
+        std::uint64_t numDocs, documentLength;
+        if (!(statsStream >> tag >> numDocs >> documentLength) || tag != "STATS") {
+            active[s] = false;
+            errors[s] = statsReplies[s].ok ? "bad STATS response" : statsReplies[s].error;
+            continue;
+        }
+        totalDocuments += numDocs;
+        totalDocumentLength += documentLength;
+        std::vector<long long> shardFrequencies;
+        long long docFrequency;
+        while (statsStream >> docFrequency) {
+            shardFrequencies.push_back(docFrequency);
+        }
+        docFrequencies.resize(shardFrequencies.size(), 0);
+        for (size_t t = 0; t < shardFrequencies.size(); ++t) {
+            docFrequencies[t] += shardFrequencies[t];
+        }
+        anyResponded = true;
+    }
+
+    std::vector<Result> results;
+    bool searched = false;
+    if (!anyResponded) {
+        // No shard answered; reported below
+    } else if (docFrequencies.empty()) {
+        std::cout << "No terms found in query." << std::endl;
+    } else {
+        bool anyFound = false;
+        bool allFound = true;
+        for (long long docFrequency : docFrequencies) {
+            anyFound = anyFound || docFrequency > 0;
+            allFound = allFound && docFrequency > 0;
+        }
+        if (conjunctive ? !allFound : !anyFound) {
+            std::cout << "No matching documents found." << std::endl;
+        } else {
+            // Phase 2: search every shard with the global statistics and merge. Each shard
+            // returns one result per near-duplicate cluster; when clusters repeat across
+            // shards and leave fewer than k results, search deeper while a shard may have more.
+            char avgDocumentLength[32];
+            std::snprintf(avgDocumentLength, sizeof(avgDocumentLength), "%.17g",
+                          static_cast<double>(totalDocumentLength) / static_cast<double>(totalDocuments));
+            for (int depth = k; ; depth *= 2) {
+                std::ostringstream request;
+                request << "SEARCH\t" << (conjunctive ? "1" : "0") << "\t" << depth << "\t" << totalDocuments << "\t"
+                        << avgDocumentLength << "\t";
+                for (size_t t = 0; t < docFrequencies.size(); ++t) {
+                    request << (t > 0 ? " " : "") << docFrequencies[t];
+                }
+                request << "\t" << cleanQuery;
+
+                results.clear();
+                bool anyFull = false;
+                std::vector<ShardReply> searchReplies = scatter(endpoints, active, request.str(), timeoutMs);
+                for (size_t s = 0; s < endpoints.size(); ++s) {
+                    if (!active[s]) {
+                        continue;
+                    }
+                    latencyMs[s] += searchReplies[s].latencyMs;
+                    if (!searchReplies[s].ok) {
+                        active[s] = false;
+                        errors[s] = searchReplies[s].error;
+                        continue;
+                    }
+                    int numResults = 0;
+                    for (const std::string& line : searchReplies[s].lines) {
+                        // RESULT<TAB>docID<TAB>score<TAB>snippet<TAB>highlights<TAB>cluster
+                        std::vector<std::string> fields;
+                        std::stringstream lineStream(line);
+                        std::string field;
+                        while (std::getline(lineStream, field, '\t')) {
+                            fields.push_back(field);
+                        }
+                        fields.resize(std::max<size_t>(fields.size(), 6));
+                        if (fields[0] == "RESULT") {
+                            results.push_back({ std::atoi(fields[1].c_str()), std::strtod(fields[2].c_str(), nullptr),
+                                                fields[3], fields[4], fields[5] });
+                            numResults++;
+                        }
+                    }
+                    anyFull = anyFull || numResults >= depth;
+                }
+
+                std::sort(results.begin(), results.end(), rankBefore);
+                std::unordered_set<std::string> seenClusters;
+                std::vector<Result> collapsed;
+                for (Result& result : results) {
+                    if (result.cluster.empty() || seenClusters.insert(result.cluster).second) {
+                        collapsed.push_back(std::move(result));
+                    }
+                }
+                results.swap(collapsed);
+                if (results.size() >= static_cast<size_t>(k) || !anyFull) {
+                    break;
+                }
+            }
+            searched = true;
+        }
+    }
+
+    if (searched) {
+        std::sort(results.begin(), results.end(), rankBefore);
+        if (results.size() > static_cast<size_t>(k)) {
+            results.resize(k);
+        }
+        std::cout << "Top " << k << " documents:" << std::endl;
+        for (const Result& result : results) {
+            std::cout << "DocID: " << result.docID << ", Score: " << result.score << std::endl;
+            std::cout << "Snippet: " << result.snippet << std::endl;
+            std::cout << "Highlights:" << (result.highlights.empty() ? "" : " ") << result.highlights << std::endl;
+        }
+    }
+
+    // Per-shard latency of both round trips, and which shards are missing from the results
+    int responded = 0;
+    std::cout << "Shard latency:" << std::endl;
+    for (size_t s = 0; s < endpoints.size(); ++s) {
+        std::cout << "  Shard " << s << " (" << endpoints[s].host << ":" << endpoints[s].port << "): ";
+        if (active[s]) {
+            responded++;
+            std::cout << latencyMs[s] << " ms" << std::endl;
+        } else {
+            std::cout << errors[s] << " after " << latencyMs[s] << " ms" << std::endl;
+        }
+    }
+    if (responded < static_cast<int>(endpoints.size())) {
+        std::cout << "Partial results: " << responded << " of " << endpoints.size() << " shards responded." << std::endl;
+    }
+    if (responded == 0) {
+        std::cerr << "Error: no shard responded" << std::endl;
+        return 1;
+    }
+    return 0;
+}
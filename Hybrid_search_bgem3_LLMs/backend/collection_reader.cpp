@@ -0,0 +1,104 @@
+#include "collection_reader.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+CollectionReader::CollectionReader() : fd(-1), fileSize(0), metadata(nullptr) {
+}
+
+CollectionReader::~CollectionReader() {
+    close();
+}
+
+bool CollectionReader::open(const std::string& filePath, const DocMetadata& metadata) {
+    close();
+    fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close();
+        return false;
+    }
+    fileSize = static_cast<std::uint64_t>(fileStat.st_size);
+    this->metadata = &metadata;
+    // Result passages are scattered across the file; sequential readahead would be wasted
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+    return true;
+}
+
+void CollectionReader::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    fileSize = 0;
+    metadata = nullptr;
+}
+
+void CollectionReader::lineRange(int docID, std::uint64_t& start, std::uint64_t& end) const {
+    start = metadata->offset(docID);
+    end = static_cast<std::uint64_t>(docID) + 1 < metadata->numDocs() ? metadata->offset(docID + 1) : fileSize;
+    // After docID reordering the next document may live anywhere in the file
+    if (end <= start || end - start > MAX_EXACT_LINE) {
+        end = start + LINE_READ_SIZE;
+    }
+    end = std::max(start, std::min(end, fileSize));
+}
+
+std::vector<std::string> CollectionReader::getPassages(const std::vector<int>& docIDs) const {
+    std::vector<std::string> passages(docIDs.size());
+
+    // Visit the requested documents in file order
+    std::vector<size_t> order;
+    for (size_t i = 0; i < docIDs.size(); ++i) {
+        if (docIDs[i] >= 0 && static_cast<std::uint64_t>(docIDs[i]) < metadata->numDocs()) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return metadata->offset(docIDs[a]) < metadata->offset(docIDs[b]);
+    });
+
+    // Announce every range up front so the kernel can schedule all the reads together
+    for (size_t i : order) {
+        std::uint64_t start, end;
+        lineRange(docIDs[i], start, end);
+        posix_fadvise(fd, start, end - start, POSIX_FADV_WILLNEED);
+    }
+
+    std::string line;
+    for (size_t i : order) {
+        std::uint64_t start, end;
+        lineRange(docIDs[i], start, end);
+        line.resize(end - start);
+        size_t bytesRead = 0;
+        while (true) {
+            while (bytesRead < line.size()) {
+                ssize_t result = ::pread(fd, &line[bytesRead], line.size() - bytesRead, start + bytesRead);
+                if (result <= 0) {
+                    break;
+                }
+                bytesRead += static_cast<size_t>(result);
+            }
+            // Keep reading when the estimated range stopped short of the newline
+            if (bytesRead < line.size() || line.find('\n') != std::string::npos || start + bytesRead >= fileSize) {
+                break;
+            }
+            line.resize(line.size() + LINE_READ_SIZE);
+        }
+        line.resize(bytesRead);
+
+        // Split "passageID<TAB>passageText[<TAB>...]\n"
+        line.resize(std::min(line.size(), line.find('\n')));
+        size_t idEnd = line.find('\t');
+        if (idEnd == std::string::npos) {
+            continue;
+        }
+        size_t textEnd = line.find('\t', idEnd + 1);
+        passages[i] = line.substr(idEnd + 1, textEnd == std::string::npos ? std::string::npos : textEnd - idEnd - 1);
+    }
+    return passages;
+}
@@ -0,0 +1,44 @@
+#ifndef COLLECTION_READER_H
+#define COLLECTION_READER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "doc_metadata.h"
+
+// Reads passage texts straight from collection.tsv, using the line offsets recorded in
+// the document metadata. In parser docID order each line's extent runs to the next
+// document's offset, so a batch of results can be fetched with one exact pread per
+// passage; after reordering, lines are read in fixed-size steps up to their newline.
+class CollectionReader {
+public:
+    // Bytes read per step when a line's extent is not known from the next document
+    static const std::uint64_t LINE_READ_SIZE = 4096;
+    // Longest gap to the next document's offset that is still read as one line
+    static const std::uint64_t MAX_EXACT_LINE = 64 * 1024;
+
+    CollectionReader();
+    ~CollectionReader();
+    CollectionReader(const CollectionReader&) = delete;
+    CollectionReader& operator=(const CollectionReader&) = delete;
+
+    bool open(const std::string& filePath, const DocMetadata& metadata);
+    void close();
+    bool is_open() const { return fd >= 0; }
+
+    // Fetch the passages of several documents, returned in the order of docIDs. Reads are
+    // issued in file order after hinting every range to the kernel, so a cold-cache result
+    // page costs one pass over the disk instead of a seek per result.
+    std::vector<std::string> getPassages(const std::vector<int>& docIDs) const;
+
+private:
+    int fd;
+    std::uint64_t fileSize;
+    const DocMetadata* metadata;
+
+    // Byte range expected to hold a document's line: up to the next document's offset when
+    // that is close, otherwise one read step
+    void lineRange(int docID, std::uint64_t& start, std::uint64_t& end) const;
+};
+
+#endif // COLLECTION_READER_H
@@ -0,0 +1,72 @@
+#include "deleted_docs.h"
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+DeletedDocs::DeletedDocs() : numDocs(0), deletedCount(0), deletedTokens(0) {
+}
+
+bool DeletedDocs::load(const std::string& filePath, std::uint64_t numDocs) {
+    this->numDocs = numDocs;
+    deletedCount = 0;
+    deletedTokens = 0;
+    words.assign((numDocs + 63) / 64, 0);
+
+    std::ifstream inFile(filePath, std::ios::binary);
+    if (!inFile.is_open()) {
+        return true; // Nothing deleted
+    }
+    DeletedDocsHeader header;
+    inFile.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!inFile || std::memcmp(header.magic, DELETED_DOCS_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << "Error: Not a deleted-documents file: " << filePath << std::endl;
+        return false;
+    }
+    if (header.numDocs != numDocs) {
+        std::cerr << "Error: " << filePath << " covers " << header.numDocs << " documents, the index has "
+                  << numDocs << std::endl;
+        return false;
+    }
+    inFile.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(std::uint64_t));
+    if (!inFile) {
+        std::cerr << "Error: Truncated deleted-documents file: " << filePath << std::endl;
+        return false;
+    }
+    deletedCount = header.numDeleted;
+    deletedTokens = header.deletedLength;
+    return true;
+}
+
+bool DeletedDocs::write(const std::string& filePath) const {
+    std::string tempFile = filePath + ".tmp";
+    std::ofstream outFile(tempFile, std::ios::binary);
+    if (!outFile.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << tempFile << std::endl;
+        return false;
+    }
+    DeletedDocsHeader header;
+    std::memcpy(header.magic, DELETED_DOCS_MAGIC, sizeof(header.magic));
+    header.numDocs = numDocs;
+    header.numDeleted = deletedCount;
+    header.deletedLength = deletedTokens;
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outFile.write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(std::uint64_t));
+    outFile.close();
+    if (!outFile.good() || std::rename(tempFile.c_str(), filePath.c_str()) != 0) {
+        std::cerr << "Error: Unable to write " << filePath << std::endl;
+        std::remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool DeletedDocs::markDeleted(int docID, std::uint32_t length) {
+    if (docID < 0 || static_cast<std::uint64_t>(docID) >= numDocs || isDeleted(docID)) {
+        return false;
+    }
+    words[docID >> 6] |= std::uint64_t(1) << (docID & 63);
+    deletedCount++;
+    deletedTokens += length;
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef DELETED_DOCS_H
+#define DELETED_DOCS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Tombstones for one index directory (a single index, shard or segment). Deleted documents
+// stay in the posting lists but are skipped by the query processor and left out of the
+// collection statistics; they are physically dropped when segments are merged or the
+// index is reordered.
+//
+// Layout: DeletedDocsHeader, then ceil(numDocs / 64) uint64 words with bit d of the
+// bitmap set when local docID d is deleted. A missing file means nothing is deleted.
+const std::string DELETED_DOCS_FILE_NAME = "deleted_docs.bin";
+
+struct DeletedDocsHeader {
+    char magic[8];
+    std::uint64_t numDocs;
+    std::uint64_t numDeleted;
+    std::uint64_t deletedLength;   // Total tokens of the deleted documents
+};
+
+const char DELETED_DOCS_MAGIC[8] = {'D', 'E', 'L', 'D', 'O', 'C', 'S', '1'};
+
+class DeletedDocs {
+public:
+    DeletedDocs();
+
+    // Load the bitmap of an index with numDocs documents; a missing file leaves it empty
+    bool load(const std::string& filePath, std::uint64_t numDocs);
+    // Written to a temporary file and renamed, so readers never see a partial bitmap
+    bool write(const std::string& filePath) const;
+
+    bool isDeleted(int docID) const {
+        std::uint64_t word = static_cast<std::uint64_t>(docID) >> 6;
+        return word < words.size() && ((words[word] >> (docID & 63)) & 1) != 0;
+    }
+    // Returns false if the document was already deleted
+    bool markDeleted(int docID, std::uint32_t length);
+
+    std::uint64_t numDeleted() const { return deletedCount; }
+    std::uint64_t deletedLength() const { return deletedTokens; }
+
+private:
+    std::uint64_t numDocs;
+    std::uint64_t deletedCount;
+    std::uint64_t deletedTokens;
+    std::vector<std::uint64_t> words;
+};
+
+#endif // DELETED_DOCS_H
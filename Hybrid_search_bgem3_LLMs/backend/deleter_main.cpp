@@ -0,0 +1,93 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <unordered_set>
+#include "shards.h"
+#include "doc_metadata.h"
+#include "deleted_docs.h"
+
+// Delete passages by passage ID without rebuilding: marks them in the deleted-documents
+// bitmap of the index directory (single index, shard or segment) that holds them.
+int main(int argc, char* argv[]) {
+    std::unordered_set<std::string> passageIDs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 6, "--ids=") == 0) {
+            // One passage ID per line
+            std::ifstream idsIn(arg.substr(6));
+            if (!idsIn.is_open()) {
+                std::cerr << "Error opening file: " << arg.substr(6) << std::endl;
+                return 1;
+            }
+            std::string line;
+            while (std::getline(idsIn, line)) {
+                if (!line.empty()) {
+                    passageIDs.insert(line);
+                }
+            }
+        } else if (arg.compare(0, 2, "--") != 0) {
+            passageIDs.insert(arg);
+        } else {
+            passageIDs.clear();
+            break;
+        }
+    }
+    if (passageIDs.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--ids=FILE] [passageID ...]" << std::endl;
+        return 1;
+    }
+
+    // Hold the manifest lock so a concurrent segment merge cannot drop these deletions
+    ManifestLock manifestLock;
+    if (!manifestLock.locked()) {
+        return 1;
+    }
+    std::vector<ShardInfo> shards;
+    if (!readShardManifest(SHARD_MANIFEST_FILE, shards)) {
+        shards.push_back({ "tmp/", 0, 0 });
+    }
+
+    size_t numDeleted = 0;
+    size_t numAlreadyDeleted = 0;
+    std::unordered_set<std::string> found;
+    for (const ShardInfo& shard : shards) {
+        DocMetadata metadata;
+        DeletedDocs deletedDocs;
+        std::string deletedDocsFile = shard.directory + DELETED_DOCS_FILE_NAME;
+        if (!metadata.open(shard.directory + "doc_metadata.bin") || !deletedDocs.load(deletedDocsFile, metadata.numDocs())) {
+            std::cerr << "Error: Unable to open document files in " << shard.directory << std::endl;
+            return 1;
+        }
+
+        size_t shardDeleted = 0;
+        for (int docID = 0; docID < static_cast<int>(metadata.numDocs()); ++docID) {
+            std::string passageID = metadata.passageID(docID);
+            if (passageIDs.count(passageID) == 0) {
+                continue;
+            }
+            found.insert(passageID);
+            if (deletedDocs.markDeleted(docID, metadata.length(docID))) {
+                shardDeleted++;
+            } else {
+                numAlreadyDeleted++;
+            }
+        }
+        if (shardDeleted > 0 && !deletedDocs.write(deletedDocsFile)) {
+            return 1;
+        }
+        numDeleted += shardDeleted;
+    }
+
+    std::cout << "[INFO] Deleted " << numDeleted << " documents";
+    if (numAlreadyDeleted > 0) {
+        std::cout << ", " << numAlreadyDeleted << " were already deleted";
+    }
+    std::cout << "." << std::endl;
+    for (const std::string& passageID : passageIDs) {
+        if (found.count(passageID) == 0) {
+            std::cout << "[WARN] Passage not found: " << passageID << std::endl;
+        }
+    }
+    return 0;
+}
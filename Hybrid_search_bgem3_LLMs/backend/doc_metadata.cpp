@@ -0,0 +1,208 @@
+#include "doc_metadata.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+// Variable-byte coding with the stop bit on the last byte, as in the inverted index
+static void appendVarByte(std::uint32_t number, std::vector<std::uint8_t>& bytes) {
+    while (number >= 0x80) {
+        bytes.push_back(static_cast<std::uint8_t>(number & 0x7F));
+        number >>= 7;
+    }
+    bytes.push_back(static_cast<std::uint8_t>(number | 0x80));
+}
+
+static std::uint32_t readVarByte(const std::uint8_t*& data) {
+    std::uint32_t number = 0;
+    int shift = 0;
+    while (true) {
+        std::uint8_t byte = *data++;
+        number |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+        if (byte & 0x80) {
+            return number;
+        }
+        shift += 7;
+    }
+}
+
+static std::uint64_t alignTo8(std::uint64_t offset) {
+    return (offset + 7) & ~static_cast<std::uint64_t>(7);
+}
+
+// DocMetadataBuilder implementation
+DocMetadataBuilder::DocMetadataBuilder() : hasClusters(false), maxLength(0), totalDocumentLength(0) {
+}
+
+void DocMetadataBuilder::addDocument(std::string_view passageID, std::uint32_t length, std::uint64_t offset,
+                                     std::uint32_t clusterID) {
+    size_t shared = 0;
+    if (offsets.size() % PASSAGE_ID_BLOCK_SIZE == 0) {
+        // First ID of a block is stored whole so blocks decode independently
+        idIndex.push_back(idData.size());
+        appendVarByte(passageID.size(), idData);
+    } else {
+        size_t limit = std::min(previousID.size(), passageID.size());
+        while (shared < limit && previousID[shared] == passageID[shared]) {
+            shared++;
+        }
+        appendVarByte(shared, idData);
+        appendVarByte(passageID.size() - shared, idData);
+    }
+    idData.insert(idData.end(), passageID.begin() + shared, passageID.end());
+    previousID.assign(passageID.data(), passageID.size());
+
+    lengths.push_back(length);
+    offsets.push_back(offset);
+    clusterIDs.push_back(clusterID);
+    hasClusters = hasClusters || clusterID != NO_CLUSTER_ID;
+    maxLength = std::max(maxLength, length);
+    totalDocumentLength += length;
+}
+
+bool DocMetadataBuilder::write(const std::string& filePath) const {
+    std::string tempFile = filePath + ".tmp";
+    std::ofstream outFile(tempFile, std::ios::binary);
+    if (!outFile.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << filePath << std::endl;
+        return false;
+    }
+
+    // Most passages are short, so lengths usually fit in 16 bits
+    DocMetadataHeader header;
+    std::memcpy(header.magic, DOC_METADATA_MAGIC, sizeof(header.magic));
+    header.version = DOC_METADATA_VERSION;
+    header.lengthWidth = maxLength <= UINT16_MAX ? 2 : 4;
+    header.numDocs = offsets.size();
+    header.totalDocumentLength = totalDocumentLength;
+    header.lengthsOffset = alignTo8(sizeof(DocMetadataHeader));
+    header.offsetsOffset = alignTo8(header.lengthsOffset + header.numDocs * header.lengthWidth);
+    header.idIndexOffset = header.offsetsOffset + header.numDocs * sizeof(std::uint64_t);
+    header.idDataOffset = header.idIndexOffset + idIndex.size() * sizeof(std::uint64_t);
+    header.idDataSize = idData.size();
+    header.clusterIDsOffset = hasClusters ? alignTo8(header.idDataOffset + header.idDataSize) : 0;
+    std::uint64_t end = hasClusters ? header.clusterIDsOffset + header.numDocs * sizeof(std::uint32_t)
+                                    : header.idDataOffset + header.idDataSize;
+    header.analysisOffset = end;
+    header.analysisSize = analysis.size();
+
+    const char padding[8] = {0};
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outFile.write(padding, header.lengthsOffset - sizeof(header));
+    if (header.lengthWidth == 2) {
+        std::vector<std::uint16_t> narrowLengths(lengths.begin(), lengths.end());
+        outFile.write(reinterpret_cast<const char*>(narrowLengths.data()), narrowLengths.size() * sizeof(std::uint16_t));
+    } else {
+        outFile.write(reinterpret_cast<const char*>(lengths.data()), lengths.size() * sizeof(std::uint32_t));
+    }
+    outFile.write(padding, header.offsetsOffset - (header.lengthsOffset + header.numDocs * header.lengthWidth));
+    outFile.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(std::uint64_t));
+    outFile.write(reinterpret_cast<const char*>(idIndex.data()), idIndex.size() * sizeof(std::uint64_t));
+    outFile.write(reinterpret_cast<const char*>(idData.data()), idData.size());
+    if (hasClusters) {
+        outFile.write(padding, header.clusterIDsOffset - (header.idDataOffset + header.idDataSize));
+        outFile.write(reinterpret_cast<const char*>(clusterIDs.data()), clusterIDs.size() * sizeof(std::uint32_t));
+    }
+    outFile.write(analysis.data(), analysis.size());
+    outFile.close();
+
+    if (!outFile.good() || std::rename(tempFile.c_str(), filePath.c_str()) != 0) {
+        std::cerr << "Error: Failed writing to " << filePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// DocMetadata implementation
+DocMetadata::DocMetadata()
+    : lengths16(nullptr), lengths32(nullptr), offsets(nullptr), idIndex(nullptr), idData(nullptr), clusterIDs(nullptr) {
+    std::memset(&header, 0, sizeof(header));
+}
+
+bool DocMetadata::open(const std::string& filePath) {
+    close();
+    if (!file.open(filePath)) {
+        std::cerr << "Error opening document metadata file: " << filePath << std::endl;
+        return false;
+    }
+
+    if (file.size() < sizeof(DocMetadataHeader)) {
+        std::cerr << "Error: Document metadata file is truncated: " << filePath << std::endl;
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, DOC_METADATA_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != DOC_METADATA_VERSION ||
+        (header.lengthWidth != 2 && header.lengthWidth != 4) ||
+        header.idDataOffset + header.idDataSize > file.size() ||
+        (header.clusterIDsOffset != 0 && header.clusterIDsOffset + header.numDocs * sizeof(std::uint32_t) > file.size()) ||
+        header.analysisOffset + header.analysisSize > file.size()) {
+        std::cerr << "Error: Unrecognized document metadata file: " << filePath << std::endl;
+        file.close();
+        std::memset(&header, 0, sizeof(header));
+        return false;
+    }
+
+    const char* base = file.data();
+    if (header.lengthWidth == 2) {
+        lengths16 = reinterpret_cast<const std::uint16_t*>(base + header.lengthsOffset);
+    } else {
+        lengths32 = reinterpret_cast<const std::uint32_t*>(base + header.lengthsOffset);
+    }
+    offsets = reinterpret_cast<const std::uint64_t*>(base + header.offsetsOffset);
+    idIndex = reinterpret_cast<const std::uint64_t*>(base + header.idIndexOffset);
+    idData = reinterpret_cast<const std::uint8_t*>(base + header.idDataOffset);
+    if (header.clusterIDsOffset != 0) {
+        clusterIDs = reinterpret_cast<const std::uint32_t*>(base + header.clusterIDsOffset);
+    }
+    return true;
+}
+
+void DocMetadata::close() {
+    file.close();
+    std::memset(&header, 0, sizeof(header));
+    lengths16 = nullptr;
+    lengths32 = nullptr;
+    offsets = nullptr;
+    idIndex = nullptr;
+    idData = nullptr;
+    clusterIDs = nullptr;
+}
+
+double DocMetadata::avgDocumentLength() const {
+    if (header.numDocs == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(header.totalDocumentLength) / header.numDocs;
+}
+
+std::uint32_t DocMetadata::length(int docID) const {
+    return lengths16 != nullptr ? lengths16[docID] : lengths32[docID];
+}
+
+std::uint64_t DocMetadata::offset(int docID) const {
+    return offsets[docID];
+}
+
+std::string DocMetadata::analysis() const {
+    return std::string(file.data() + header.analysisOffset, header.analysisSize);
+}
+
+std::string DocMetadata::passageID(int docID) const {
+    const std::uint8_t* data = idData + idIndex[docID / PASSAGE_ID_BLOCK_SIZE];
+    std::string id;
+    std::uint32_t firstSize = readVarByte(data);
+    id.assign(reinterpret_cast<const char*>(data), firstSize);
+    data += firstSize;
+
+    for (int i = 0; i < docID % PASSAGE_ID_BLOCK_SIZE; ++i) {
+        std::uint32_t shared = readVarByte(data);
+        std::uint32_t suffixSize = readVarByte(data);
+        id.resize(shared);
+        id.append(reinterpret_cast<const char*>(data), suffixSize);
+        data += suffixSize;
+    }
+    return id;
+}
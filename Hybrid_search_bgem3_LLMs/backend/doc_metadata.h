@@ -0,0 +1,112 @@
+#ifndef DOC_METADATA_H
+#define DOC_METADATA_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "mapped_file.h"
+
+// Binary per-document metadata, written by the parser and mapped by the query processor.
+//
+// Layout (all integers little-endian, every section 8-byte aligned):
+//   DocMetadataHeader
+//   lengths      numDocs x uint16 or uint32 (lengthWidth), tokens per document
+//   offsets      numDocs x uint64, byte offset of each document's line in the collection
+//   idIndex      numIDBlocks x uint64, start of each passage-ID block within idData
+//   idData       front-coded passage IDs in blocks of PASSAGE_ID_BLOCK_SIZE
+//   clusterIDs   numDocs x uint32, near-duplicate cluster of each document; only present
+//                when the parser detected near-duplicates (clusterIDsOffset is 0 otherwise)
+//   analysis     analysisSize bytes, TextAnalysis::describe() of the stemming and stopwords
+//                applied to the indexed tokens; empty when there were none
+//
+// Each passage-ID block stores its first ID as (varint length, bytes) and every later ID
+// as (varint shared prefix with the previous ID, varint suffix length, suffix bytes).
+struct DocMetadataHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t lengthWidth;
+    std::uint64_t numDocs;
+    std::uint64_t totalDocumentLength;
+    std::uint64_t lengthsOffset;
+    std::uint64_t offsetsOffset;
+    std::uint64_t idIndexOffset;
+    std::uint64_t idDataOffset;
+    std::uint64_t idDataSize;
+    std::uint64_t clusterIDsOffset;
+    std::uint64_t analysisOffset;
+    std::uint64_t analysisSize;
+};
+
+const char DOC_METADATA_MAGIC[8] = {'D', 'O', 'C', 'M', 'E', 'T', 'A', '1'};
+const std::uint32_t DOC_METADATA_VERSION = 3;
+const int PASSAGE_ID_BLOCK_SIZE = 16;
+// Cluster ID of a document that belongs to no near-duplicate cluster, such as one added
+// by the indexer
+const std::uint32_t NO_CLUSTER_ID = UINT32_MAX;
+
+// Accumulates documents in docID order and writes the metadata file
+class DocMetadataBuilder {
+public:
+    DocMetadataBuilder();
+
+    // Documents must be added in docID order starting at 0. The cluster ID column is only
+    // written if some document has one.
+    void addDocument(std::string_view passageID, std::uint32_t length, std::uint64_t offset,
+                     std::uint32_t clusterID = NO_CLUSTER_ID);
+    std::uint64_t numDocs() const { return offsets.size(); }
+    // Record the analysis the documents' tokens went through (TextAnalysis::describe())
+    void setAnalysis(const std::string& description) { analysis = description; }
+    // Written to a temporary file and renamed into place
+    bool write(const std::string& filePath) const;
+
+private:
+    std::vector<std::uint32_t> lengths;
+    std::vector<std::uint64_t> offsets;
+    std::vector<std::uint64_t> idIndex;
+    std::vector<std::uint8_t> idData;
+    std::vector<std::uint32_t> clusterIDs;
+    bool hasClusters;
+    std::string analysis;
+    std::string previousID;
+    std::uint32_t maxLength;
+    std::uint64_t totalDocumentLength;
+};
+
+// Read-only view of a metadata file; all lookups are array accesses into the mapping
+class DocMetadata {
+public:
+    DocMetadata();
+
+    bool open(const std::string& filePath);
+    void close();
+    bool is_open() const { return file.is_open(); }
+    // Fault the whole file into memory ahead of the first queries
+    void warm() const { file.warm(); }
+
+    std::uint64_t numDocs() const { return header.numDocs; }
+    std::uint64_t totalDocumentLength() const { return header.totalDocumentLength; }
+    double avgDocumentLength() const;
+    std::uint32_t length(int docID) const;
+    std::uint64_t offset(int docID) const;
+    // Decode a passage ID; only its block is scanned
+    std::string passageID(int docID) const;
+    // Near-duplicates share a cluster ID (see near_duplicates.h); NO_CLUSTER_ID when the
+    // document has none or the index was built without near-duplicate detection
+    bool hasClusters() const { return clusterIDs != nullptr; }
+    std::uint32_t clusterID(int docID) const { return clusterIDs != nullptr ? clusterIDs[docID] : NO_CLUSTER_ID; }
+    // Description of the stemming and stopwords the index was built with (see text_analysis.h)
+    std::string analysis() const;
+
+private:
+    MappedFile file;
+    DocMetadataHeader header;
+    const std::uint16_t* lengths16;
+    const std::uint32_t* lengths32;
+    const std::uint64_t* offsets;
+    const std::uint64_t* idIndex;
+    const std::uint8_t* idData;
+    const std::uint32_t* clusterIDs;
+};
+
+#endif // DOC_METADATA_H
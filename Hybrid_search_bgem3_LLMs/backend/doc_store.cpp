@@ -0,0 +1,270 @@
+#include "doc_store.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <zlib.h>
+#include <unistd.h>
+
+// DocStoreWriter implementation
+DocStoreWriter::DocStoreWriter() : fileOffset(0), numDocs(0) {
+}
+
+bool DocStoreWriter::open(const std::string& filePath) {
+    this->filePath = filePath;
+    outFile.open(filePath + ".tmp", std::ios::binary);
+    if (!outFile.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << filePath << std::endl;
+        return false;
+    }
+
+    // Reserve the header; it is rewritten by close() once the directory is known
+    DocStoreHeader header;
+    std::memset(&header, 0, sizeof(header));
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fileOffset = sizeof(header);
+    directory.clear();
+    passageEnds.assign(1, 0);
+    blockText.clear();
+    numDocs = 0;
+    return true;
+}
+
+void DocStoreWriter::addPassage(std::string_view text) {
+    if (blockText.size() + text.size() > DOC_STORE_BLOCK_SIZE && passageEnds.size() > 1) {
+        flushBlock();
+    }
+    if (passageEnds.size() == 1) {
+        directory.push_back({0, 0, 0, numDocs});
+    }
+    blockText.append(text.data(), text.size());
+    passageEnds.push_back(static_cast<std::uint32_t>(blockText.size()));
+    numDocs++;
+}
+
+void DocStoreWriter::flushBlock() {
+    // Assemble count, end offsets and texts, then compress them as one unit
+    std::uint32_t count = static_cast<std::uint32_t>(passageEnds.size() - 1);
+    size_t endsSize = passageEnds.size() * sizeof(std::uint32_t);
+    rawBlock.resize(sizeof(count) + endsSize + blockText.size());
+    std::memcpy(rawBlock.data(), &count, sizeof(count));
+    std::memcpy(rawBlock.data() + sizeof(count), passageEnds.data(), endsSize);
+    std::memcpy(rawBlock.data() + sizeof(count) + endsSize, blockText.data(), blockText.size());
+
+    uLongf compressedSize = compressBound(rawBlock.size());
+    compressedBlock.resize(compressedSize);
+    if (compress2(compressedBlock.data(), &compressedSize, rawBlock.data(), rawBlock.size(), Z_DEFAULT_COMPRESSION) != Z_OK) {
+        std::cerr << "Error: Failed to compress document store block" << std::endl;
+        outFile.setstate(std::ios::badbit);
+        return;
+    }
+    outFile.write(reinterpret_cast<const char*>(compressedBlock.data()), compressedSize);
+
+    DocStoreBlockEntry& entry = directory.back();
+    entry.fileOffset = fileOffset;
+    entry.compressedSize = static_cast<std::uint32_t>(compressedSize);
+    entry.rawSize = static_cast<std::uint32_t>(rawBlock.size());
+    fileOffset += compressedSize;
+
+    passageEnds.assign(1, 0);
+    blockText.clear();
+}
+
+bool DocStoreWriter::saveState(std::ostream& out) {
+    outFile.flush();
+    std::uint64_t numEntries = directory.size();
+    std::uint64_t numEnds = passageEnds.size();
+    std::uint64_t textSize = blockText.size();
+    out.write(reinterpret_cast<const char*>(&fileOffset), sizeof(fileOffset));
+    out.write(reinterpret_cast<const char*>(&numDocs), sizeof(numDocs));
+    out.write(reinterpret_cast<const char*>(&numEntries), sizeof(numEntries));
+    out.write(reinterpret_cast<const char*>(directory.data()), numEntries * sizeof(DocStoreBlockEntry));
+    out.write(reinterpret_cast<const char*>(&numEnds), sizeof(numEnds));
+    out.write(reinterpret_cast<const char*>(passageEnds.data()), numEnds * sizeof(std::uint32_t));
+    out.write(reinterpret_cast<const char*>(&textSize), sizeof(textSize));
+    out.write(blockText.data(), textSize);
+    return outFile.good() && out.good();
+}
+
+bool DocStoreWriter::resume(const std::string& filePath, std::istream& in) {
+    this->filePath = filePath;
+    std::uint64_t numEntries = 0;
+    std::uint64_t numEnds = 0;
+    std::uint64_t textSize = 0;
+    in.read(reinterpret_cast<char*>(&fileOffset), sizeof(fileOffset));
+    in.read(reinterpret_cast<char*>(&numDocs), sizeof(numDocs));
+    in.read(reinterpret_cast<char*>(&numEntries), sizeof(numEntries));
+    directory.resize(in ? numEntries : 0);
+    in.read(reinterpret_cast<char*>(directory.data()), directory.size() * sizeof(DocStoreBlockEntry));
+    in.read(reinterpret_cast<char*>(&numEnds), sizeof(numEnds));
+    passageEnds.resize(in ? numEnds : 0);
+    in.read(reinterpret_cast<char*>(passageEnds.data()), passageEnds.size() * sizeof(std::uint32_t));
+    in.read(reinterpret_cast<char*>(&textSize), sizeof(textSize));
+    blockText.resize(in ? textSize : 0);
+    in.read(&blockText[0], blockText.size());
+    if (!in || passageEnds.empty()) {
+        std::cerr << "Error: Invalid document store state for " << filePath << std::endl;
+        return false;
+    }
+
+    // Blocks written after the state was saved are written again
+    std::string tempFile = filePath + ".tmp";
+    if (truncate(tempFile.c_str(), static_cast<off_t>(fileOffset)) != 0) {
+        std::cerr << "Error: Unable to resume " << tempFile << std::endl;
+        return false;
+    }
+    outFile.open(tempFile, std::ios::binary | std::ios::in | std::ios::out);
+    if (!outFile.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << filePath << std::endl;
+        return false;
+    }
+    outFile.seekp(0, std::ios::end);
+    return true;
+}
+
+bool DocStoreWriter::close() {
+    if (passageEnds.size() > 1) {
+        flushBlock();
+    }
+
+    // Align the directory so the reader can use it in place
+    const char padding[8] = {0};
+    size_t paddingSize = (8 - fileOffset % 8) % 8;
+    outFile.write(padding, paddingSize);
+    fileOffset += paddingSize;
+
+    DocStoreHeader header;
+    std::memcpy(header.magic, DOC_STORE_MAGIC, sizeof(header.magic));
+    header.version = DOC_STORE_VERSION;
+    header.reserved = 0;
+    header.numDocs = numDocs;
+    header.numBlocks = directory.size();
+    header.directoryOffset = fileOffset;
+    outFile.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(DocStoreBlockEntry));
+    outFile.seekp(0);
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outFile.close();
+
+    if (outFile.fail() || std::rename((filePath + ".tmp").c_str(), filePath.c_str()) != 0) {
+        std::cerr << "Error: Failed writing to " << filePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void DocStoreWriter::discard() {
+    outFile.close();
+    std::remove((filePath + ".tmp").c_str());
+}
+
+// DocStore implementation
+DocStore::DocStore(size_t cacheBlocks) : directory(nullptr), cacheBlocks(std::max<size_t>(1, cacheBlocks)) {
+    std::memset(&header, 0, sizeof(header));
+}
+
+bool DocStore::open(const std::string& filePath) {
+    if (!file.open(filePath)) {
+        return false;
+    }
+    if (file.size() < sizeof(DocStoreHeader)) {
+        std::cerr << "Error: Document store is truncated: " << filePath << std::endl;
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, DOC_STORE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != DOC_STORE_VERSION ||
+        header.directoryOffset + header.numBlocks * sizeof(DocStoreBlockEntry) > file.size()) {
+        std::cerr << "Error: Unrecognized document store: " << filePath << std::endl;
+        file.close();
+        std::memset(&header, 0, sizeof(header));
+        return false;
+    }
+    directory = reinterpret_cast<const DocStoreBlockEntry*>(file.data() + header.directoryOffset);
+    return true;
+}
+
+DocStore::BlockPtr DocStore::loadBlock(std::uint64_t blockIndex) {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        for (auto it = cache.begin(); it != cache.end(); ++it) {
+            if (it->first == blockIndex) {
+                cache.splice(cache.begin(), cache, it);
+                return it->second;
+            }
+        }
+    }
+
+    // Decompress outside the lock so other threads can keep hitting the cache
+    const DocStoreBlockEntry& entry = directory[blockIndex];
+    auto block = std::make_shared<std::vector<std::uint8_t>>(entry.rawSize);
+    uLongf rawSize = entry.rawSize;
+    const Bytef* source = reinterpret_cast<const Bytef*>(file.data() + entry.fileOffset);
+    if (uncompress(block->data(), &rawSize, source, entry.compressedSize) != Z_OK || rawSize != entry.rawSize) {
+        std::cerr << "Error: Corrupt document store block " << blockIndex << std::endl;
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache.emplace_front(blockIndex, block);
+    if (cache.size() > cacheBlocks) {
+        cache.pop_back();
+    }
+    return block;
+}
+
+std::uint64_t DocStore::findBlock(int docID) const {
+    // Last block whose first docID is not after the requested one
+    const DocStoreBlockEntry* end = directory + header.numBlocks;
+    const DocStoreBlockEntry* entry = std::upper_bound(directory, end, static_cast<std::uint64_t>(docID),
+        [](std::uint64_t id, const DocStoreBlockEntry& block) { return id < block.firstDocID; }) - 1;
+    return entry - directory;
+}
+
+std::string DocStore::passageFromBlock(const std::vector<std::uint8_t>& block, std::uint64_t blockIndex, int docID) const {
+    const std::uint8_t* data = block.data();
+    std::uint32_t count;
+    std::memcpy(&count, data, sizeof(count));
+    std::uint64_t index = docID - directory[blockIndex].firstDocID;
+    std::uint32_t ends[2];
+    std::memcpy(ends, data + sizeof(count) + index * sizeof(std::uint32_t), sizeof(ends));
+    const char* text = reinterpret_cast<const char*>(data + sizeof(count) + (count + 1) * sizeof(std::uint32_t));
+    return std::string(text + ends[0], ends[1] - ends[0]);
+}
+
+std::string DocStore::getPassage(int docID) {
+    if (docID < 0 || static_cast<std::uint64_t>(docID) >= header.numDocs) {
+        return "";
+    }
+    std::uint64_t blockIndex = findBlock(docID);
+    BlockPtr block = loadBlock(blockIndex);
+    if (block == nullptr) {
+        return "";
+    }
+    return passageFromBlock(*block, blockIndex, docID);
+}
+
+std::vector<std::string> DocStore::getPassages(const std::vector<int>& docIDs) {
+    std::vector<std::string> passages(docIDs.size());
+    std::vector<size_t> order;
+    for (size_t i = 0; i < docIDs.size(); ++i) {
+        if (docIDs[i] >= 0 && static_cast<std::uint64_t>(docIDs[i]) < header.numDocs) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return docIDs[a] < docIDs[b]; });
+
+    BlockPtr block;
+    std::uint64_t blockIndex = 0;
+    for (size_t i : order) {
+        std::uint64_t needed = findBlock(docIDs[i]);
+        if (block == nullptr || needed != blockIndex) {
+            blockIndex = needed;
+            block = loadBlock(blockIndex);
+        }
+        if (block != nullptr) {
+            passages[i] = passageFromBlock(*block, blockIndex, docIDs[i]);
+        }
+    }
+    return passages;
+}
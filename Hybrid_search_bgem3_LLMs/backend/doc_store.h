@@ -0,0 +1,109 @@
+#ifndef DOC_STORE_H
+#define DOC_STORE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <list>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "mapped_file.h"
+
+// Compressed passage store, written by the parser and read by the query processor.
+//
+// Layout:
+//   DocStoreHeader
+//   blocks       zlib-compressed blocks of consecutive passages
+//   directory    numBlocks x DocStoreBlockEntry, at header.directoryOffset
+//
+// A decompressed block is: uint32 count, (count + 1) x uint32 end offsets of each
+// passage relative to the text area (the first entry is 0), then the passage texts.
+struct DocStoreHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t numDocs;
+    std::uint64_t numBlocks;
+    std::uint64_t directoryOffset;
+};
+
+struct DocStoreBlockEntry {
+    std::uint64_t fileOffset;
+    std::uint32_t compressedSize;
+    std::uint32_t rawSize;
+    std::uint64_t firstDocID;
+};
+
+const char DOC_STORE_MAGIC[8] = {'D', 'O', 'C', 'S', 'T', 'O', 'R', '1'};
+const std::uint32_t DOC_STORE_VERSION = 1;
+// Uncompressed passage bytes collected before a block is compressed
+const size_t DOC_STORE_BLOCK_SIZE = 64 * 1024;
+
+// Appends passages in docID order and compresses them block by block. Written to a
+// temporary file that close() renames into place.
+class DocStoreWriter {
+public:
+    DocStoreWriter();
+
+    bool open(const std::string& filePath);
+    void addPassage(std::string_view text);
+    bool close();
+    // Stop writing and delete the temporary file, leaving any existing store in place
+    void discard();
+
+    // Flush what has been written and save the rest of the writer's state (directory and
+    // the passages of the unfinished block), so an interrupted build can continue the file
+    bool saveState(std::ostream& out);
+    // Continue a partly written store from a saved state, dropping anything written after it
+    bool resume(const std::string& filePath, std::istream& in);
+
+private:
+    std::ofstream outFile;
+    std::string filePath;
+    std::uint64_t fileOffset;
+    std::vector<DocStoreBlockEntry> directory;
+    std::vector<std::uint32_t> passageEnds;
+    std::string blockText;
+    std::vector<std::uint8_t> rawBlock;
+    std::vector<std::uint8_t> compressedBlock;
+    std::uint64_t numDocs;
+
+    void flushBlock();
+};
+
+// Random access to passages; safe to call from several threads at once. Recently used
+// blocks are kept decompressed in a small LRU cache.
+class DocStore {
+public:
+    static const size_t DEFAULT_CACHE_BLOCKS = 32;
+
+    explicit DocStore(size_t cacheBlocks = DEFAULT_CACHE_BLOCKS);
+
+    bool open(const std::string& filePath);
+    bool is_open() const { return file.is_open(); }
+    std::uint64_t numDocs() const { return header.numDocs; }
+    // Returns an empty string for unknown docIDs
+    std::string getPassage(int docID);
+    // Fetch several passages, returned in the order of docIDs; documents are visited in
+    // docID order so each block is decompressed at most once per batch
+    std::vector<std::string> getPassages(const std::vector<int>& docIDs);
+
+private:
+    typedef std::shared_ptr<const std::vector<std::uint8_t>> BlockPtr;
+
+    MappedFile file;
+    DocStoreHeader header;
+    const DocStoreBlockEntry* directory;
+
+    size_t cacheBlocks;
+    std::mutex cacheMutex;
+    std::list<std::pair<std::uint64_t, BlockPtr>> cache;   // Most recently used first
+
+    BlockPtr loadBlock(std::uint64_t blockIndex);
+    std::uint64_t findBlock(int docID) const;
+    std::string passageFromBlock(const std::vector<std::uint8_t>& block, std::uint64_t blockIndex, int docID) const;
+};
+
+#endif // DOC_STORE_H
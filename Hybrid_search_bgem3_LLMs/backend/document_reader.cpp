@@ -0,0 +1,705 @@
+#include "document_reader.h"
+#include "gzip_reader.h"
+#include "mapped_file.h"
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+
+// Contiguous view of the input from the current position onwards. A mapped file is one
+// window over the whole file; decompressed input is buffered piece by piece, and the
+// bytes before the position are dropped by compact().
+class ByteWindow {
+public:
+    virtual ~ByteWindow() {}
+
+    const char* data() const { return base + position; }
+    size_t size() const { return length - position; }
+    // Input offset of data()
+    std::uint64_t offset() const { return baseOffset + position; }
+    void consume(size_t count) { position += count; }
+    // Append more input after size(); may move data(). Returns false at the end of the input.
+    virtual bool more() = 0;
+    // Drop consumed input; invalidates pointers into it
+    virtual void compact() {}
+    virtual bool failed() const { return false; }
+
+protected:
+    const char* base = nullptr;
+    size_t length = 0;
+    size_t position = 0;
+    std::uint64_t baseOffset = 0;
+};
+
+class MappedWindow : public ByteWindow {
+public:
+    bool open(const std::string& filePath) {
+        if (!file.open(filePath, true)) {
+            return false;
+        }
+        base = file.data();
+        length = file.size();
+        return true;
+    }
+    bool more() override { return false; }
+
+private:
+    MappedFile file;
+};
+
+class GzipWindow : public ByteWindow {
+public:
+    explicit GzipWindow(int numThreads) : reader(numThreads) {}
+
+    bool open(const std::string& filePath) { return reader.open(filePath); }
+    bool more() override {
+        if (!reader.read(piece)) {
+            return false;
+        }
+        buffer.append(piece);
+        base = buffer.data();
+        length = buffer.size();
+        return true;
+    }
+    void compact() override {
+        // Only once the consumed bytes dominate, so moving the rest is amortized
+        if (position > 0 && position >= buffer.size() / 2) {
+            buffer.erase(0, position);
+            baseOffset += position;
+            position = 0;
+            base = buffer.data();
+            length = buffer.size();
+        }
+    }
+    bool failed() const override { return reader.failed(); }
+
+private:
+    ParallelGzipReader reader;
+    std::string buffer;
+    std::string piece;
+};
+
+// Offset of needle at or after from, relative to window.data(), reading more input as
+// needed; npos if the input ends first
+static size_t findInWindow(ByteWindow& window, std::string_view needle, size_t from) {
+    while (true) {
+        std::string_view view(window.data(), window.size());
+        size_t found = view.find(needle, from);
+        if (found != std::string_view::npos) {
+            return found;
+        }
+        // A match may straddle the old end of the window
+        from = view.size() >= needle.size() ? view.size() - needle.size() + 1 : 0;
+        if (!window.more()) {
+            return std::string_view::npos;
+        }
+    }
+}
+
+// Next line without its newline; the last line may lack one
+static bool readLine(ByteWindow& window, std::string_view& line) {
+    if (window.size() == 0 && !window.more()) {
+        return false;
+    }
+    size_t end = findInWindow(window, "\n", 0);
+    if (end == std::string_view::npos) {
+        line = std::string_view(window.data(), window.size());
+        window.consume(window.size());
+    } else {
+        line = std::string_view(window.data(), end);
+        window.consume(end + 1);
+    }
+    return true;
+}
+
+static bool startsWithNoCase(std::string_view text, size_t position, std::string_view prefix) {
+    if (text.size() - position < prefix.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < prefix.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(text[position + i])) != prefix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t findNoCase(std::string_view text, std::string_view needle, size_t from) {
+    for (size_t position = from; position + needle.size() <= text.size(); ++position) {
+        if (startsWithNoCase(text, position, needle)) {
+            return position;
+        }
+    }
+    return std::string_view::npos;
+}
+
+static void appendUtf8(std::string& out, unsigned long codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xc0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xe0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x110000) {
+        out += static_cast<char>(0xf0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+}
+
+// Append text to out on one line: whitespace runs become a single space. With markup,
+// HTML/SGML tags are removed (scripts, styles and comments with their contents) and
+// character entities decoded.
+static void appendText(std::string& out, std::string_view text, bool markup) {
+    auto appendSpace = [&out]() {
+        if (!out.empty() && out.back() != ' ') {
+            out += ' ';
+        }
+    };
+    size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        if (markup && c == '<') {
+            size_t end;
+            if (text.compare(i, 4, "<!--") == 0) {
+                end = text.find("-->", i + 4);
+                end = end == std::string_view::npos ? text.size() : end + 3;
+            } else if (startsWithNoCase(text, i, "<script") || startsWithNoCase(text, i, "<style")) {
+                end = findNoCase(text, startsWithNoCase(text, i, "<script") ? "</script" : "</style", i + 1);
+                end = end == std::string_view::npos ? text.size() : text.find('>', end);
+                end = end == std::string_view::npos ? text.size() : end + 1;
+            } else {
+                end = text.find('>', i);
+                end = end == std::string_view::npos ? text.size() : end + 1;
+            }
+            appendSpace();
+            i = end;
+        } else if (markup && c == '&') {
+            size_t semicolon = text.find(';', i);
+            std::string_view entity = semicolon != std::string_view::npos && semicolon - i <= 10
+                ? text.substr(i + 1, semicolon - i - 1) : std::string_view();
+            unsigned long codePoint = 0;
+            if (entity == "amp") {
+                codePoint = '&';
+            } else if (entity == "lt") {
+                codePoint = '<';
+            } else if (entity == "gt") {
+                codePoint = '>';
+            } else if (entity == "quot") {
+                codePoint = '"';
+            } else if (entity == "apos") {
+                codePoint = '\'';
+            } else if (entity == "nbsp") {
+                codePoint = ' ';
+            } else if (entity.size() > 1 && entity[0] == '#') {
+                bool hex = entity[1] == 'x' || entity[1] == 'X';
+                codePoint = std::strtoul(std::string(entity.substr(hex ? 2 : 1)).c_str(), nullptr, hex ? 16 : 10);
+            }
+            if (codePoint == 0) {
+                out += c;
+                i++;
+            } else {
+                if (codePoint == ' ') {
+                    appendSpace();
+                } else {
+                    appendUtf8(out, codePoint);
+                }
+                i = semicolon + 1;
+            }
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            appendSpace();
+            i++;
+        } else {
+            out += c;
+            i++;
+        }
+    }
+    if (!out.empty() && out.back() == ' ') {
+        out.pop_back();
+    }
+}
+
+static std::string_view trim(std::string_view text) {
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// DocumentReader implementation
+DocumentReader::DocumentReader(std::unique_ptr<ByteWindow> window) : window(std::move(window)), truncated(false) {
+}
+
+DocumentReader::~DocumentReader() {
+}
+
+std::uint64_t DocumentReader::offset() const {
+    return window->offset();
+}
+
+bool DocumentReader::seek(std::uint64_t offset) {
+    window->compact();
+    while (window->offset() + window->size() < offset) {
+        window->consume(window->size());
+        window->compact();
+        if (!window->more()) {
+            return false;
+        }
+    }
+    window->consume(offset - window->offset());
+    return true;
+}
+
+bool DocumentReader::failed() const {
+    return truncated || window->failed();
+}
+
+// passageID<TAB>passageText[<TAB>...], one document per line
+class TsvReader : public DocumentReader {
+public:
+    explicit TsvReader(std::unique_ptr<ByteWindow> window) : DocumentReader(std::move(window)) {}
+
+    bool next(SourceDocument& document) override {
+        window->compact();
+        document.offset = window->offset();
+        std::string_view line;
+        if (!readLine(*window, line)) {
+            return false;
+        }
+        size_t idEnd = line.find('\t');
+        document.passageID = line.substr(0, idEnd);
+        document.text = std::string_view();
+        if (idEnd != std::string_view::npos) {
+            document.text = line.substr(idEnd + 1);
+            document.text = document.text.substr(0, document.text.find('\t'));
+        }
+        return true;
+    }
+};
+
+// One JSON object per line; only top-level string (or, for IDs, number) fields are used
+class JsonlReader : public DocumentReader {
+public:
+    explicit JsonlReader(std::unique_ptr<ByteWindow> window) : DocumentReader(std::move(window)) {}
+
+    bool next(SourceDocument& document) override {
+        while (true) {
+            window->compact();
+            document.offset = window->offset();
+            std::string_view line;
+            if (!readLine(*window, line)) {
+                return false;
+            }
+            if (trim(line).empty()) {
+                continue;
+            }
+            if (parseObject(line)) {
+                document.passageID = passageID;
+                document.text = text;
+                return true;
+            }
+            if (numWarnings++ < MAX_WARNINGS) {
+                std::cerr << "[WARN] Skipping JSON line without an ID and text at offset " << document.offset << std::endl;
+            }
+        }
+    }
+
+private:
+    static const int MAX_WARNINGS = 10;
+    static constexpr const char* ID_FIELDS[] = {"id", "docid", "doc_id", "_id"};
+    static constexpr const char* TEXT_FIELDS[] = {"contents", "text", "body", "passage"};
+
+    std::string passageID;
+    std::string text;
+    std::string key;
+    std::string value;
+    int numWarnings = 0;
+
+    static void skipSpace(std::string_view json, size_t& i) {
+        while (i < json.size() && std::isspace(static_cast<unsigned char>(json[i]))) {
+            i++;
+        }
+    }
+
+    // Decode the string starting at json[i] == '"' into out
+    static bool parseString(std::string_view json, size_t& i, std::string& out) {
+        out.clear();
+        i++;
+        while (i < json.size()) {
+            char c = json[i++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (i >= json.size()) {
+                return false;
+            }
+            char escape = json[i++];
+            switch (escape) {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    if (json.size() - i < 4) {
+                        return false;
+                    }
+                    unsigned long codePoint = std::strtoul(std::string(json.substr(i, 4)).c_str(), nullptr, 16);
+                    i += 4;
+                    // A surrogate pair encodes one code point outside the BMP
+                    if (codePoint >= 0xd800 && codePoint < 0xdc00 && json.size() - i >= 6 && json[i] == '\\' && json[i + 1] == 'u') {
+                        unsigned long low = std::strtoul(std::string(json.substr(i + 2, 4)).c_str(), nullptr, 16);
+                        if (low >= 0xdc00 && low < 0xe000) {
+                            codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                            i += 6;
+                        }
+                    }
+                    appendUtf8(out, codePoint);
+                    break;
+                }
+                default: out += escape; break;
+            }
+        }
+        return false;
+    }
+
+    // Skip any value; strings inside nested values are skipped as strings so their
+    // brackets do not count
+    static bool skipValue(std::string_view json, size_t& i) {
+        int depth = 0;
+        std::string ignored;
+        while (i < json.size()) {
+            char c = json[i];
+            if (c == '"') {
+                if (!parseString(json, i, ignored)) {
+                    return false;
+                }
+            } else if (c == '{' || c == '[') {
+                depth++;
+                i++;
+            } else if (c == '}' || c == ']') {
+                if (depth == 0) {
+                    return true;
+                }
+                depth--;
+                i++;
+            } else if (c == ',' && depth == 0) {
+                return true;
+            } else {
+                i++;
+            }
+        }
+        return depth == 0;
+    }
+
+    static int fieldRank(const std::string& name, const char* const* fields, int numFields) {
+        for (int f = 0; f < numFields; ++f) {
+            if (name == fields[f]) {
+                return f;
+            }
+        }
+        return numFields;
+    }
+
+    bool parseObject(std::string_view json) {
+        const int numIDFields = sizeof(ID_FIELDS) / sizeof(ID_FIELDS[0]);
+        const int numTextFields = sizeof(TEXT_FIELDS) / sizeof(TEXT_FIELDS[0]);
+        int idRank = numIDFields;
+        int textRank = numTextFields;
+        size_t i = 0;
+        skipSpace(json, i);
+        if (i >= json.size() || json[i] != '{') {
+            return false;
+        }
+        i++;
+        while (true) {
+            skipSpace(json, i);
+            if (i < json.size() && json[i] == '}') {
+                break;
+            }
+            if (i >= json.size() || json[i] != '"' || !parseString(json, i, key)) {
+                return false;
+            }
+            skipSpace(json, i);
+            if (i >= json.size() || json[i] != ':') {
+                return false;
+            }
+            i++;
+            skipSpace(json, i);
+            int keyIDRank = fieldRank(key, ID_FIELDS, numIDFields);
+            int keyTextRank = fieldRank(key, TEXT_FIELDS, numTextFields);
+            if (i < json.size() && json[i] == '"') {
+                if (!parseString(json, i, value)) {
+                    return false;
+                }
+                if (keyIDRank < idRank) {
+                    idRank = keyIDRank;
+                    passageID.clear();
+                    appendText(passageID, value, false);
+                } else if (keyTextRank < textRank) {
+                    textRank = keyTextRank;
+                    text.clear();
+                    appendText(text, value, false);
+                }
+            } else {
+                size_t valueStart = i;
+                if (!skipValue(json, i)) {
+                    return false;
+                }
+                // Numeric IDs are used as written
+                std::string_view number = trim(json.substr(valueStart, i - valueStart));
+                if (keyIDRank < idRank && !number.empty() && (std::isdigit(static_cast<unsigned char>(number[0])) || number[0] == '-')) {
+                    idRank = keyIDRank;
+                    passageID.assign(number.data(), number.size());
+                }
+            }
+            skipSpace(json, i);
+            if (i < json.size() && json[i] == ',') {
+                i++;
+            }
+        }
+        return idRank < numIDFields && textRank < numTextFields;
+    }
+};
+
+constexpr const char* JsonlReader::ID_FIELDS[];
+constexpr const char* JsonlReader::TEXT_FIELDS[];
+
+// <DOC> ... </DOC> records with a <DOCNO>
+class TrecReader : public DocumentReader {
+public:
+    explicit TrecReader(std::unique_ptr<ByteWindow> window) : DocumentReader(std::move(window)) {}
+
+    bool next(SourceDocument& document) override {
+        while (true) {
+            window->compact();
+            size_t start = findInWindow(*window, "<DOC>", 0);
+            if (start == std::string_view::npos) {
+                window->consume(window->size());
+                return false;
+            }
+            size_t end = findInWindow(*window, "</DOC>", start + 5);
+            if (end == std::string_view::npos) {
+                std::cerr << "Error: Input ends inside the TREC record at offset " << window->offset() + start << std::endl;
+                truncated = true;
+                window->consume(window->size());
+                return false;
+            }
+            std::string_view record(window->data() + start + 5, end - start - 5);
+            document.offset = window->offset() + start;
+            window->consume(end + 6);
+
+            size_t idStart = record.find("<DOCNO>");
+            size_t idEnd = idStart == std::string_view::npos ? idStart : record.find("</DOCNO>", idStart);
+            if (idEnd == std::string_view::npos) {
+                std::cerr << "[WARN] Skipping TREC record without a DOCNO at offset " << document.offset << std::endl;
+                continue;
+            }
+            passageID.clear();
+            appendText(passageID, record.substr(idStart + 7, idEnd - idStart - 7), false);
+
+            // The <TEXT> sections if there are any, otherwise everything after the DOCNO
+            text.clear();
+            size_t textStart = findNoCase(record, "<text>", 0);
+            while (textStart != std::string_view::npos) {
+                size_t textEnd = findNoCase(record, "</text>", textStart + 6);
+                if (!text.empty()) {
+                    text += ' ';
+                }
+                appendText(text, record.substr(textStart + 6, textEnd == std::string_view::npos ? std::string_view::npos : textEnd - textStart - 6), true);
+                textStart = textEnd == std::string_view::npos ? textEnd : findNoCase(record, "<text>", textEnd + 7);
+            }
+            if (findNoCase(record, "<text>", 0) == std::string_view::npos) {
+                appendText(text, record.substr(idEnd + 8), true);
+            }
+            document.passageID = passageID;
+            document.text = text;
+            return true;
+        }
+    }
+
+private:
+    std::string passageID;
+    std::string text;
+};
+
+// WARC/1.0 records: headers, a blank line, Content-Length bytes of content
+class WarcReader : public DocumentReader {
+public:
+    explicit WarcReader(std::unique_ptr<ByteWindow> window) : DocumentReader(std::move(window)) {}
+
+    bool next(SourceDocument& document) override {
+        while (true) {
+            window->compact();
+            size_t start = findInWindow(*window, "WARC/", 0);
+            if (start == std::string_view::npos) {
+                window->consume(window->size());
+                return false;
+            }
+            window->consume(start);
+            document.offset = window->offset();
+            size_t headerEnd = findInWindow(*window, "\r\n\r\n", 0);
+            if (headerEnd == std::string_view::npos) {
+                std::cerr << "Error: Input ends inside the WARC record headers at offset " << document.offset << std::endl;
+                truncated = true;
+                window->consume(window->size());
+                return false;
+            }
+
+            std::string type;
+            std::string recordID;
+            std::string trecID;
+            long long contentLength = -1;
+            std::string_view headers(window->data(), headerEnd);
+            size_t lineStart = 0;
+            while (lineStart < headers.size()) {
+                size_t lineEnd = headers.find("\r\n", lineStart);
+                std::string_view line = headers.substr(lineStart, lineEnd == std::string_view::npos ? std::string_view::npos : lineEnd - lineStart);
+                lineStart = lineEnd == std::string_view::npos ? headers.size() : lineEnd + 2;
+                size_t colon = line.find(':');
+                if (colon == std::string_view::npos) {
+                    continue;
+                }
+                std::string name(trim(line.substr(0, colon)));
+                std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+                std::string_view value = trim(line.substr(colon + 1));
+                if (name == "warc-type") {
+                    type.assign(value.data(), value.size());
+                } else if (name == "warc-record-id") {
+                    recordID.assign(value.data(), value.size());
+                } else if (name == "warc-trec-id") {
+                    trecID.assign(value.data(), value.size());
+                } else if (name == "content-length") {
+                    contentLength = std::atoll(std::string(value).c_str());
+                }
+            }
+            if (contentLength < 0) {
+                std::cerr << "[WARN] Skipping WARC record without Content-Length at offset " << document.offset << std::endl;
+                window->consume(5);
+                continue;
+            }
+
+            size_t contentStart = headerEnd + 4;
+            size_t recordEnd = contentStart + static_cast<size_t>(contentLength);
+            while (window->size() < recordEnd) {
+                if (!window->more()) {
+                    std::cerr << "Error: Input ends inside the WARC record at offset " << document.offset << std::endl;
+                    truncated = true;
+                    window->consume(window->size());
+                    return false;
+                }
+            }
+            std::string_view content(window->data() + contentStart, static_cast<size_t>(contentLength));
+            window->consume(recordEnd);
+            if (type != "response" && type != "resource" && type != "conversion") {
+                continue;
+            }
+
+            // Drop the HTTP status line and headers of a response, and skip responses
+            // that are not text (images, PDFs and the like)
+            if (type == "response" && content.compare(0, 5, "HTTP/") == 0) {
+                size_t bodyStart = content.find("\r\n\r\n");
+                std::string_view httpHeaders = content.substr(0, bodyStart);
+                size_t contentType = findNoCase(httpHeaders, "\ncontent-type:", 0);
+                if (contentType != std::string_view::npos) {
+                    std::string_view mediaType = trim(httpHeaders.substr(contentType + 14, httpHeaders.find('\n', contentType + 1) - contentType - 14));
+                    if (!startsWithNoCase(mediaType, 0, "text/") && findNoCase(mediaType, "xml", 0) == std::string_view::npos) {
+                        continue;
+                    }
+                }
+                content = bodyStart == std::string_view::npos ? std::string_view() : content.substr(bodyStart + 4);
+            }
+            passageID = !trecID.empty() ? trecID : recordID;
+            if (passageID.size() > 2 && passageID.front() == '<' && passageID.back() == '>') {
+                passageID = passageID.substr(1, passageID.size() - 2);
+            }
+            text.clear();
+            appendText(text, content, type != "conversion");
+            document.passageID = passageID;
+            document.text = text;
+            return true;
+        }
+    }
+
+private:
+    std::string passageID;
+    std::string text;
+};
+
+bool parseCollectionFormat(const std::string& name, CollectionFormat& format) {
+    if (name == "tsv") {
+        format = CollectionFormat::TSV;
+    } else if (name == "jsonl") {
+        format = CollectionFormat::JSONL;
+    } else if (name == "trec") {
+        format = CollectionFormat::TREC;
+    } else if (name == "warc") {
+        format = CollectionFormat::WARC;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+CollectionFormat formatFromFileName(const std::string& filePath) {
+    std::string name = filePath;
+    if (name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0) {
+        name.resize(name.size() - 3);
+    }
+    auto endsWith = [&name](const std::string& suffix) {
+        return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (endsWith(".jsonl") || endsWith(".json")) {
+        return CollectionFormat::JSONL;
+    }
+    if (endsWith(".trec")) {
+        return CollectionFormat::TREC;
+    }
+    if (endsWith(".warc")) {
+        return CollectionFormat::WARC;
+    }
+    return CollectionFormat::TSV;
+}
+
+std::unique_ptr<DocumentReader> openDocumentReader(const std::string& filePath, CollectionFormat format, int numThreads) {
+    std::unique_ptr<ByteWindow> window;
+    if (ParallelGzipReader::isGzipFile(filePath)) {
+        auto gzipWindow = std::make_unique<GzipWindow>(numThreads);
+        if (!gzipWindow->open(filePath)) {
+            return nullptr;
+        }
+        window = std::move(gzipWindow);
+    } else {
+        auto mappedWindow = std::make_unique<MappedWindow>();
+        if (!mappedWindow->open(filePath)) {
+            std::cerr << "Error opening file: " << filePath << std::endl;
+            return nullptr;
+        }
+        window = std::move(mappedWindow);
+    }
+
+    switch (format) {
+        case CollectionFormat::JSONL:
+            return std::make_unique<JsonlReader>(std::move(window));
+        case CollectionFormat::TREC:
+            return std::make_unique<TrecReader>(std::move(window));
+        case CollectionFormat::WARC:
+            return std::make_unique<WarcReader>(std::move(window));
+        case CollectionFormat::TSV:
+        default:
+            return std::make_unique<TsvReader>(std::move(window));
+    }
+}
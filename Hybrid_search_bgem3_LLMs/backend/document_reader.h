@@ -0,0 +1,68 @@
+#ifndef DOCUMENT_READER_H
+#define DOCUMENT_READER_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+
+// Streaming readers for the collection formats the parser can index. Every format can
+// also be gzip-compressed (detected from the file's magic bytes); compressed files are
+// decompressed on several threads (see gzip_reader.h) while the parser tokenizes.
+//
+//   tsv    passageID<TAB>passageText[<TAB>...], one document per line (collection.tsv)
+//   jsonl  one JSON object per line; the ID is the first of "id", "docid", "doc_id" or
+//          "_id" and the text the first of "contents", "text", "body" or "passage"
+//   trec   <DOC><DOCNO>id</DOCNO>...</DOC> records; the text of the <TEXT> sections,
+//          or of the whole record when there are none, with markup removed
+//   warc   WARC response, resource and conversion records; the ID is WARC-TREC-ID or
+//          else WARC-Record-ID, and HTTP headers and HTML markup are removed
+//
+// Texts from jsonl, trec and warc are normalized to one line (tabs and line breaks become
+// spaces), as the document store, snippets and the broker protocol expect.
+//
+// Offsets are byte offsets in the decompressed input. For an uncompressed TSV file they
+// are the line offsets that the collection reader uses to fetch passages without the
+// document store; for other inputs passages are only available from the document store.
+enum class CollectionFormat { TSV, JSONL, TREC, WARC };
+
+// Parse a --format name; returns false if it is unknown
+bool parseCollectionFormat(const std::string& name, CollectionFormat& format);
+// Format implied by a file name: .jsonl/.json, .trec, .warc, else TSV; a .gz suffix is ignored
+CollectionFormat formatFromFileName(const std::string& filePath);
+
+struct SourceDocument {
+    std::string_view passageID;
+    std::string_view text;
+    std::uint64_t offset;      // Where the document's record starts
+};
+
+class ByteWindow;
+
+class DocumentReader {
+public:
+    virtual ~DocumentReader();
+
+    // Read the next document; its views stay valid until the next call. Returns false at
+    // the end of the input or on an error (see failed()).
+    virtual bool next(SourceDocument& document) = 0;
+    // Offset of the input just past the last document returned
+    std::uint64_t offset() const;
+    // Continue reading at an offset returned by offset(), e.g. from a parser checkpoint.
+    // Compressed input is decompressed and discarded up to it.
+    bool seek(std::uint64_t offset);
+    // True once the input turned out to end in the middle of a record or to be corrupt
+    bool failed() const;
+
+protected:
+    explicit DocumentReader(std::unique_ptr<ByteWindow> window);
+    std::unique_ptr<ByteWindow> window;
+    // Set when the input ends in the middle of a record
+    bool truncated;
+};
+
+// Open filePath in the given format, decompressing gzip input on numThreads threads.
+// Returns nullptr if the file cannot be opened.
+std::unique_ptr<DocumentReader> openDocumentReader(const std::string& filePath, CollectionFormat format, int numThreads);
+
+#endif // DOCUMENT_READER_H
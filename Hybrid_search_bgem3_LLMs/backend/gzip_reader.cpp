@@ -0,0 +1,209 @@
+#include "gzip_reader.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+ParallelGzipReader::ParallelGzipReader(int numThreads)
+    : numThreads(std::max(1, numThreads)), nextStart(0), error(false) {
+}
+
+ParallelGzipReader::~ParallelGzipReader() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cancelChunks(lock);
+}
+
+bool ParallelGzipReader::isGzipFile(const std::string& filePath) {
+    std::ifstream inFile(filePath, std::ios::binary);
+    unsigned char magic[2] = {0, 0};
+    inFile.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    return inFile && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+bool ParallelGzipReader::open(const std::string& filePath) {
+    this->filePath = filePath;
+    if (!file.open(filePath, true)) {
+        std::cerr << "Error opening file: " << filePath << std::endl;
+        return false;
+    }
+    if (file.size() > 0 && !isMemberStart(0)) {
+        std::cerr << "Error: Not a gzip file: " << filePath << std::endl;
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    nextStart = 0;
+    error = false;
+    planChunks();
+    return true;
+}
+
+// Gzip member header: magic, deflate, no reserved flags, a known XFL and OS byte
+bool ParallelGzipReader::isMemberStart(size_t offset) const {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data()) + offset;
+    if (file.size() - offset < 18) {
+        return false;
+    }
+    return data[0] == 0x1f && data[1] == 0x8b && data[2] == 8 && (data[3] & 0xe0) == 0 &&
+           (data[8] == 0 || data[8] == 2 || data[8] == 4) && (data[9] <= 13 || data[9] == 255);
+}
+
+// First offset at or after from that looks like a member header and starts a stream
+// zlib accepts, or the file size if there is none
+size_t ParallelGzipReader::findMemberStart(size_t from) const {
+    const char* data = file.data();
+    size_t size = file.size();
+    std::vector<unsigned char> scratch(64 * 1024);
+    while (from < size) {
+        const char* candidate = static_cast<const char*>(std::memchr(data + from, 0x1f, size - from));
+        if (candidate == nullptr) {
+            break;
+        }
+        size_t offset = candidate - data;
+        if (isMemberStart(offset)) {
+            z_stream stream;
+            std::memset(&stream, 0, sizeof(stream));
+            if (inflateInit2(&stream, 15 + 16) == Z_OK) {
+                stream.next_in = reinterpret_cast<unsigned char*>(const_cast<char*>(candidate));
+                stream.avail_in = static_cast<uInt>(std::min<size_t>(size - offset, scratch.size()));
+                stream.next_out = scratch.data();
+                stream.avail_out = static_cast<uInt>(scratch.size());
+                int ret = inflate(&stream, Z_NO_FLUSH);
+                inflateEnd(&stream);
+                if (ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR) {
+                    return offset;
+                }
+            }
+        }
+        from = offset + 1;
+    }
+    return size;
+}
+
+// Keep numThreads chunks in flight; called with the mutex held
+void ParallelGzipReader::planChunks() {
+    while (static_cast<int>(chunks.size()) < numThreads && nextStart < file.size()) {
+        auto chunk = std::make_unique<Chunk>();
+        chunk->start = nextStart;
+        chunk->limit = nextStart + CHUNK_SIZE < file.size() ? findMemberStart(nextStart + CHUNK_SIZE) : file.size();
+        nextStart = chunk->limit;
+        chunk->worker = std::thread(&ParallelGzipReader::decode, this, chunk.get());
+        chunks.push_back(std::move(chunk));
+    }
+}
+
+// Stop and discard every chunk in flight; called with the mutex held
+void ParallelGzipReader::cancelChunks(std::unique_lock<std::mutex>& lock) {
+    std::deque<std::unique_ptr<Chunk>> cancelled;
+    cancelled.swap(chunks);
+    for (auto& chunk : cancelled) {
+        chunk->cancelled = true;
+    }
+    changed.notify_all();
+    lock.unlock();
+    for (auto& chunk : cancelled) {
+        chunk->worker.join();
+    }
+    lock.lock();
+}
+
+// Queue a full piece for the reader, waiting while the chunk is too far ahead; returns
+// false if the chunk was cancelled
+bool ParallelGzipReader::deliver(Chunk* chunk, std::string& piece) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&]() { return chunk->pieces.size() < MAX_PIECES || chunk->cancelled; });
+    if (chunk->cancelled) {
+        return false;
+    }
+    chunk->pieces.push_back(std::move(piece));
+    changed.notify_all();
+    return true;
+}
+
+void ParallelGzipReader::decode(Chunk* chunk) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+    size_t size = file.size();
+    size_t position = chunk->start;
+    std::string piece(PIECE_SIZE, '\0');
+    size_t pieceSize = 0;
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    bool ok = inflateInit2(&stream, 15 + 16) == Z_OK;
+    bool finished = false;
+    while (ok && !finished) {
+        // zlib counts in 32 bits, so feed at most 1 GB at a time
+        stream.next_in = const_cast<unsigned char*>(data + position);
+        stream.avail_in = static_cast<uInt>(std::min<size_t>(size - position, static_cast<size_t>(1) << 30));
+        stream.next_out = reinterpret_cast<unsigned char*>(&piece[pieceSize]);
+        stream.avail_out = static_cast<uInt>(PIECE_SIZE - pieceSize);
+        int ret = inflate(&stream, Z_NO_FLUSH);
+        position = stream.next_in - data;
+        pieceSize = PIECE_SIZE - stream.avail_out;
+
+        if (ret == Z_STREAM_END) {
+            if (position >= chunk->limit || position >= size) {
+                finished = true;
+            } else if (isMemberStart(position)) {
+                inflateReset(&stream);
+            } else if (std::all_of(data + position, data + size, [](unsigned char byte) { return byte == 0; })) {
+                // Zero padding after the last member
+                position = size;
+                finished = true;
+            } else {
+                ok = false;
+            }
+        } else if (ret != Z_OK) {
+            // Corrupt data, or input that ends in the middle of a member
+            ok = false;
+        }
+
+        if (ok && (pieceSize == PIECE_SIZE || (finished && pieceSize > 0))) {
+            piece.resize(pieceSize);
+            if (!deliver(chunk, piece)) {
+                break;
+            }
+            piece.assign(PIECE_SIZE, '\0');
+            pieceSize = 0;
+        }
+    }
+    inflateEnd(&stream);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    chunk->end = position;
+    chunk->error = !ok;
+    chunk->done = true;
+    changed.notify_all();
+}
+
+bool ParallelGzipReader::read(std::string& piece) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!error && !chunks.empty()) {
+        Chunk* chunk = chunks.front().get();
+        changed.wait(lock, [&]() { return !chunk->pieces.empty() || chunk->done; });
+        if (!chunk->pieces.empty()) {
+            piece = std::move(chunk->pieces.front());
+            chunk->pieces.pop_front();
+            changed.notify_all();
+            return true;
+        }
+        if (chunk->error) {
+            std::cerr << "Error: Corrupt gzip data in " << filePath << " after byte " << chunk->start << std::endl;
+            error = true;
+            break;
+        }
+
+        size_t end = chunk->end;
+        chunk->worker.join();
+        chunks.pop_front();
+        if (!chunks.empty() && chunks.front()->start != end) {
+            // The next chunk began at a false header inside compressed data
+            cancelChunks(lock);
+        }
+        if (chunks.empty()) {
+            nextStart = end;
+        }
+        planChunks();
+    }
+    return false;
+}
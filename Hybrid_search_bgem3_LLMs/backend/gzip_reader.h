@@ -0,0 +1,76 @@
+#ifndef GZIP_READER_H
+#define GZIP_READER_H
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include "mapped_file.h"
+
+// Decompresses a gzip file on several threads. Files made of many gzip members (WARC
+// files, bgzip output, concatenated .gz files) are split into chunks of about CHUNK_SIZE
+// compressed bytes at the first member header after each split point, and the chunks
+// are inflated concurrently; the output is handed out in file order.
+//
+// A header found by scanning may be a false match inside compressed data. Each chunk
+// therefore decodes whole members until it ends one at or past the next chunk's start;
+// when that end is not where the next chunk started, the chunks after it are discarded
+// and decoding restarts from the true member boundary. A file with a single member is
+// decoded by one thread, still in parallel with whoever consumes the output.
+//
+// Each chunk buffers at most MAX_PIECES pieces of PIECE_SIZE bytes ahead of the reader,
+// so memory stays bounded however large the collection.
+class ParallelGzipReader {
+public:
+    static const size_t CHUNK_SIZE = static_cast<size_t>(4) << 20;
+    static const size_t PIECE_SIZE = static_cast<size_t>(1) << 20;
+    static const size_t MAX_PIECES = 8;
+
+    // numThreads chunks are decoded at a time
+    explicit ParallelGzipReader(int numThreads);
+    ~ParallelGzipReader();
+    ParallelGzipReader(const ParallelGzipReader&) = delete;
+    ParallelGzipReader& operator=(const ParallelGzipReader&) = delete;
+
+    bool open(const std::string& filePath);
+    // Next piece of decompressed data, in order; false at the end of the data or on error
+    bool read(std::string& piece);
+    bool failed() const { return error; }
+
+    // True if the file starts with the gzip magic bytes
+    static bool isGzipFile(const std::string& filePath);
+
+private:
+    struct Chunk {
+        size_t start = 0;          // Offset of the chunk's first member
+        size_t limit = 0;          // Start of the next chunk; decoding stops at a member end at or past it
+        size_t end = 0;            // Offset just past the chunk's last member, once done
+        std::deque<std::string> pieces;
+        bool done = false;
+        bool error = false;
+        bool cancelled = false;
+        std::thread worker;
+    };
+
+    MappedFile file;
+    std::string filePath;
+    int numThreads;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::unique_ptr<Chunk>> chunks;   // In flight, in file order
+    size_t nextStart;
+    bool error;
+
+    void planChunks();
+    void cancelChunks(std::unique_lock<std::mutex>& lock);
+    bool isMemberStart(size_t offset) const;
+    size_t findMemberStart(size_t from) const;
+    void decode(Chunk* chunk);
+    bool deliver(Chunk* chunk, std::string& piece);
+};
+
+#endif // GZIP_READER_H
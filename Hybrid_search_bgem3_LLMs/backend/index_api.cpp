@@ -1,20 +1,20 @@
 #include "index_api.h"
 #include <iostream>
-#include <sstream>
+#include <cstring>
 #include <vector>
 #include <algorithm>
 #include <cstdint>
 
 // Variable-byte decoding function
-int InvertedList::varByteDecode(std::istream& in) {
+int InvertedList::varByteDecode(const std::uint8_t*& in, const std::uint8_t* end) {
     int number = 0;
     int shift = 0;
     while (true) {
-        int byte = in.get();
-        if (byte == EOF) {
-            // Handle EOF
+        if (in == end) {
+            // Handle a truncated number
             return -1;
         }
+        int byte = *in++;
         if (byte & 0x80) {
             number |= (byte & 0x7F) << shift;
             break;
@@ -28,37 +28,37 @@ int InvertedList::varByteDecode(std::istream& in) {
 
 // IndexAPI implementation
 IndexAPI::IndexAPI(const std::string& indexFilePath, const std::string& lexiconFilePath)
-    : indexFilePath(indexFilePath) {
-    std::ifstream testIndexFile(indexFilePath, std::ios::binary);
-    if (!testIndexFile.is_open()) {
+    : opened(false) {
+    if (!indexFile.open(indexFilePath)) {
         std::cerr << "Error: Unable to open index file: " << indexFilePath << std::endl;
         return;
     }
-    testIndexFile.close();
-    loadLexicon(lexiconFilePath);
+    opened = loadLexicon(lexiconFilePath);
 }
 
 IndexAPI::~IndexAPI() {
     // Destructor
 }
 
-void IndexAPI::loadLexicon(const std::string& lexiconFilePath) {
+bool IndexAPI::loadLexicon(const std::string& lexiconFilePath) {
     std::ifstream inFile(lexiconFilePath);
     if (!inFile.is_open()) {
         std::cerr << "Error opening lexicon file!" << std::endl;
-        return;
+        return false;
     }
 
     std::string term;
-    int64_t offset;
-    int32_t length;
-    int docFrequency;
-
-    while (inFile >> term >> offset >> length >> docFrequency) {
-        lexicon[term] = { offset, length, docFrequency };
+    LexiconEntry entry;
+    while (readLexiconEntry(inFile, term, entry)) {
+        lexicon[term] = entry;
+    }
+    if (!inFile.eof()) {
+        std::cerr << "Error: Malformed lexicon entry after '" << term << "' in " << lexiconFilePath << std::endl;
+        return false;
     }
 
     inFile.close();
+    return true;
 }
 
 InvertedList* IndexAPI::openList(const std::string& term) {
@@ -67,7 +67,7 @@ InvertedList* IndexAPI::openList(const std::string& term) {
         // Term not found
         return nullptr;
     }
-    return new InvertedList(term, indexFilePath, it->second);
+    return new InvertedList(term, indexFile, it->second);
 }
 
 void IndexAPI::closeList(InvertedList* invList) {
@@ -75,34 +75,37 @@ void IndexAPI::closeList(InvertedList* invList) {
 }
 
 // InvertedList implementation
-InvertedList::InvertedList(const std::string& term, const std::string& indexFilePath, const LexiconEntry& lexEntry)
-    : indexFile(indexFilePath, std::ios::binary), lexEntry(lexEntry), currentBlockIndex(0),
-      postingIndexInBlock(0), endOfList(false), bytesRead(0) {
+InvertedList::InvertedList(const std::string& term, const MappedFile& indexFile, const LexiconEntry& lexEntry)
+    : listData(nullptr), lexEntry(lexEntry), numBlocks(0), currentBlockIndex(0),
+      postingIndexInBlock(0), endOfList(false), bytesRead(0), totalBytes(0) {
 
-    if (!indexFile.is_open()) {
-        std::cerr << "Error: Unable to open index file: " << indexFilePath << std::endl;
+    if (lexEntry.inlined()) {
+        loadInlinedBlock(term);
+        return;
+    }
+    if (lexEntry.offset < 0 || static_cast<size_t>(lexEntry.offset) >= indexFile.size()) {
+        std::cerr << "Error: Offset " << lexEntry.offset << " of term '" << term << "' is outside the index file" << std::endl;
         endOfList = true;
         return;
     }
-
-    // Load term metadata from the index file
-    indexFile.seekg(lexEntry.offset, std::ios::beg);
+    listData = indexFile.data() + lexEntry.offset;
+    // Never read past the end of the file, even if the lexicon says otherwise
+    totalBytes = std::min(static_cast<size_t>(lexEntry.length), indexFile.size() - static_cast<size_t>(lexEntry.offset));
 
     // Read term size and term
     size_t termSize;
-    if (!indexFile.read(reinterpret_cast<char*>(&termSize), sizeof(size_t))) {
+    if (!read(&termSize, sizeof(size_t))) {
         std::cerr << "Error reading term size for term: " << term << std::endl;
         endOfList = true;
         return;
     }
-    bytesRead += sizeof(size_t);
 
-    std::string storedTerm(termSize, '\0');
-    if (!indexFile.read(&storedTerm[0], termSize)) {
+    if (termSize > totalBytes - bytesRead) {
         std::cerr << "Error reading term string for term: " << term << std::endl;
         endOfList = true;
         return;
     }
+    std::string storedTerm(listData + bytesRead, termSize);
     bytesRead += termSize;
 
     if (storedTerm != term) {
@@ -112,24 +115,26 @@ InvertedList::InvertedList(const std::string& term, const std::string& indexFile
     }
 
     // Read number of blocks
-    if (!indexFile.read(reinterpret_cast<char*>(&numBlocks), sizeof(size_t))) {
+    if (!read(&numBlocks, sizeof(size_t))) {
         std::cerr << "Error reading number of blocks for term: " << term << std::endl;
         endOfList = true;
         return;
     }
-    bytesRead += sizeof(size_t);
-
-    // Calculate totalBytes to read based on lexEntry.length
-    totalBytes = lexEntry.length;
 
     // Start by loading the first block
     loadNextBlock();
 }
 
 InvertedList::~InvertedList() {
-    if (indexFile.is_open()) {
-        indexFile.close();
+}
+
+bool InvertedList::read(void* out, size_t size) {
+    if (size > totalBytes - bytesRead) {
+        return false;
     }
+    std::memcpy(out, listData + bytesRead, size);
+    bytesRead += size;
+    return true;
 }
 
 bool InvertedList::hasNext() {
@@ -170,6 +175,36 @@ double InvertedList::getScore() {
     return static_cast<double>(currentFreq);
 }
 
+void InvertedList::loadInlinedBlock(const std::string& term) {
+    const std::uint8_t* data = lexEntry.inlinePostings;
+    const std::uint8_t* end = data + lexEntry.length;
+    int docID = 0;
+    for (int i = 0; i < lexEntry.docFrequency; ++i) {
+        int value = varByteDecode(data, end);
+        if (value == -1) {
+            break;
+        }
+        docID = i == 0 ? value : docID + value;
+        docIDs.push_back(docID);
+    }
+    while (data < end) {
+        int freq = varByteDecode(data, end);
+        if (freq == -1) {
+            break;
+        }
+        freqs.push_back(freq);
+    }
+    if (docIDs.size() != static_cast<size_t>(lexEntry.docFrequency) || freqs.size() != docIDs.size()) {
+        std::cerr << "Error decoding the inlined postings of term: " << term << std::endl;
+        docIDs.clear();
+        freqs.clear();
+        endOfList = true;
+        return;
+    }
+    numBlocks = 1;
+    currentBlockIndex = 1;
+}
+
 void InvertedList::loadNextBlock() {
     // Load the next block from the index file
     if (currentBlockIndex >= numBlocks) {
@@ -180,19 +215,17 @@ void InvertedList::loadNextBlock() {
     // Read sizes of docIDs and freqs blocks
     size_t docIDsSize;
     size_t freqsSize;
-    if (!indexFile.read(reinterpret_cast<char*>(&docIDsSize), sizeof(size_t))) {
+    if (!read(&docIDsSize, sizeof(size_t))) {
         std::cerr << "Error reading docIDsSize from index file." << std::endl;
         endOfList = true;
         return;
     }
-    bytesRead += sizeof(size_t);
 
-    if (!indexFile.read(reinterpret_cast<char*>(&freqsSize), sizeof(size_t))) {
+    if (!read(&freqsSize, sizeof(size_t))) {
         std::cerr << "Error reading freqsSize from index file." << std::endl;
         endOfList = true;
         return;
     }
-    bytesRead += sizeof(size_t);
 
     // Sanity checks for block sizes
     const size_t MAX_BLOCK_SIZE = 100 * 1024 * 1024; // 100 MB
@@ -211,30 +244,13 @@ void InvertedList::loadNextBlock() {
         return;
     }
 
-    // Read compressed data
-    std::vector<std::uint8_t> compressedDocIDs(docIDsSize);
-    std::vector<std::uint8_t> compressedFreqs(freqsSize);
-    if (!indexFile.read(reinterpret_cast<char*>(compressedDocIDs.data()), docIDsSize)) {
-        std::cerr << "Error reading compressedDocIDs from index file." << std::endl;
-        endOfList = true;
-        return;
-    }
-    bytesRead += docIDsSize;
-
-    if (!indexFile.read(reinterpret_cast<char*>(compressedFreqs.data()), freqsSize)) {
-        std::cerr << "Error reading compressedFreqs from index file." << std::endl;
-        endOfList = true;
-        return;
-    }
-    bytesRead += freqsSize;
-
-    // Decompress docIDs
+    // Decompress docIDs straight from the mapping
+    const std::uint8_t* docIDData = reinterpret_cast<const std::uint8_t*>(listData + bytesRead);
+    const std::uint8_t* docIDEnd = docIDData + docIDsSize;
     docIDs.clear();
-    std::string docIDData(reinterpret_cast<char*>(compressedDocIDs.data()), compressedDocIDs.size());
-    std::istringstream docIDStream(docIDData);
     int docID = 0;
-    while (docIDStream.tellg() < static_cast<std::streampos>(docIDData.size())) {
-        int deltaDocID = varByteDecode(docIDStream);
+    while (docIDData < docIDEnd) {
+        int deltaDocID = varByteDecode(docIDData, docIDEnd);
         if (deltaDocID == -1) {
             std::cerr << "Error decoding deltaDocID in docIDs." << std::endl;
             break;
@@ -242,19 +258,21 @@ void InvertedList::loadNextBlock() {
         docID += deltaDocID;
         docIDs.push_back(docID);
     }
+    bytesRead += docIDsSize;
 
     // Decompress freqs
+    const std::uint8_t* freqData = reinterpret_cast<const std::uint8_t*>(listData + bytesRead);
+    const std::uint8_t* freqEnd = freqData + freqsSize;
     freqs.clear();
-    std::string freqData(reinterpret_cast<char*>(compressedFreqs.data()), compressedFreqs.size());
-    std::istringstream freqStream(freqData);
-    while (freqStream.tellg() < static_cast<std::streampos>(freqData.size())) {
-        int freq = varByteDecode(freqStream);
+    while (freqData < freqEnd) {
+        int freq = varByteDecode(freqData, freqEnd);
         if (freq == -1) {
             std::cerr << "Error decoding frequency in freqs." << std::endl;
             break;
         }
         freqs.push_back(freq);
     }
+    bytesRead += freqsSize;
 
     // Ensure that docIDs and freqs have the same size
     if (docIDs.size() != freqs.size()) {
@@ -6,13 +6,8 @@
 #include <fstream>
 #include <vector>
 #include <cstdint>
-
-// Structure to hold lexicon entries
-struct LexiconEntry {
-    int64_t offset;
-    int32_t length;
-    int docFrequency;
-};
+#include "mapped_file.h"
+#include "lexicon.h"
 
 // Forward declaration
 class InvertedList;
@@ -25,18 +20,26 @@ public:
     IndexAPI(const std::string& indexFilePath, const std::string& lexiconFilePath);
     ~IndexAPI();
 
+    // False if the index or the lexicon could not be read
+    bool is_open() const { return opened; }
+    // Fault the whole index into the page cache so the first queries do not wait on disk
+    void warm() const { indexFile.warm(); }
+
     InvertedList* openList(const std::string& term);
     void closeList(InvertedList* invList);
 
 private:
-    std::string indexFilePath; // Store index file path
+    // The index stays mapped for the lifetime of the IndexAPI, so lists keep reading the
+    // file that was opened even if a rebuild replaces it on disk
+    MappedFile indexFile;
+    bool opened;
 
-    void loadLexicon(const std::string& lexiconFilePath);
+    bool loadLexicon(const std::string& lexiconFilePath);
 };
 
 class InvertedList {
 public:
-    InvertedList(const std::string& term, const std::string& indexFilePath, const LexiconEntry& lexEntry);
+    InvertedList(const std::string& term, const MappedFile& indexFile, const LexiconEntry& lexEntry);
     ~InvertedList();
 
     // Primitives
@@ -45,7 +48,7 @@ public:
     double getScore();            // Returns the term frequency of the current posting
 
 private:
-    std::ifstream indexFile;      // Each InvertedList has its own file stream
+    const char* listData;         // The term's bytes within the mapped index, or null when inlined
     LexiconEntry lexEntry;
     size_t numBlocks;
     size_t currentBlockIndex;
@@ -61,7 +64,11 @@ private:
     size_t totalBytes;            // Total bytes to read for this inverted list
 
     void loadNextBlock();
-    int varByteDecode(std::istream& in);
+    // Decode a list inlined in its lexicon entry as the only block
+    void loadInlinedBlock(const std::string& term);
+    // Copy the next size bytes of the list; false past the end of the list
+    bool read(void* out, size_t size);
+    int varByteDecode(const std::uint8_t*& in, const std::uint8_t* end);
 };
 
 #endif // INDEX_API_H
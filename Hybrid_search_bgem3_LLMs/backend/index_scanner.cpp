@@ -0,0 +1,152 @@
+#include "index_scanner.h"
+#include <iostream>
+#include <cstring>
+
+IndexScanner::IndexScanner() : numDocs(INT_MAX), position(0), listEnd(0), corrupt(false) {
+}
+
+bool IndexScanner::open(const std::string& indexFilePath, const std::string& lexiconFilePath, int numDocs) {
+    this->indexFilePath = indexFilePath;
+    this->lexiconFilePath = lexiconFilePath;
+    this->numDocs = numDocs;
+    position = 0;
+    corrupt = false;
+    lexicon.close();
+    lexicon.clear();
+    lexicon.open(lexiconFilePath);
+    return file.open(indexFilePath, true) && lexicon.is_open();
+}
+
+bool IndexScanner::next(std::string& term, std::vector<int>& docIDs, std::vector<int>& freqs) {
+    if (corrupt) {
+        return false;
+    }
+    LexiconEntry entry;
+    if (!readLexiconEntry(lexicon, term, entry)) {
+        if (!lexicon.eof()) {
+            std::cerr << "Error: Malformed lexicon entry after '" << term << "' in " << lexiconFilePath << std::endl;
+            corrupt = true;
+        }
+        return false;
+    }
+    decodedDocIDs.clear();
+    freqs.clear();
+    if (entry.inlined()) {
+        const std::uint8_t* data = entry.inlinePostings;
+        const std::uint8_t* end = entry.inlinePostings + entry.length;
+        std::int64_t docID = 0;
+        for (int i = 0; i < entry.docFrequency; ++i) {
+            int value = decode(data, end);
+            if (value < 0) {
+                return fail(term);
+            }
+            docID = i == 0 ? value : docID + value;
+            decodedDocIDs.push_back(docID);
+        }
+        while (data < end) {
+            int freq = decode(data, end);
+            if (freq < 0) {
+                return fail(term);
+            }
+            freqs.push_back(freq);
+        }
+    } else {
+        // Lists are stored in lexicon order, so this only skips the term header
+        if (entry.offset < 0 || entry.length < 0 || static_cast<std::uint64_t>(entry.offset) + entry.length > file.size()) {
+            return fail(term);
+        }
+        position = static_cast<size_t>(entry.offset);
+        listEnd = position + static_cast<size_t>(entry.length);
+        size_t termSize;
+        size_t numBlocks;
+        if (!readSize(termSize) || termSize > listEnd - position) {
+            return fail(term);
+        }
+        position += termSize;
+        if (!readSize(numBlocks)) {
+            return fail(term);
+        }
+
+        for (size_t block = 0; block < numBlocks; ++block) {
+            size_t docIDsSize;
+            size_t freqsSize;
+            if (!readSize(docIDsSize) || !readSize(freqsSize) || docIDsSize > listEnd - position ||
+                freqsSize > listEnd - position - docIDsSize) {
+                return fail(term);
+            }
+            const std::uint8_t* data = reinterpret_cast<const std::uint8_t*>(file.data() + position);
+
+            // DocIDs are gaps within the block, starting from an absolute docID
+            const std::uint8_t* end = data + docIDsSize;
+            std::int64_t docID = 0;
+            bool first = true;
+            while (data < end) {
+                int value = decode(data, end);
+                if (value < 0) {
+                    return fail(term);
+                }
+                docID = first ? value : docID + value;
+                first = false;
+                decodedDocIDs.push_back(docID);
+            }
+            end = data + freqsSize;
+            while (data < end) {
+                int freq = decode(data, end);
+                if (freq < 0) {
+                    return fail(term);
+                }
+                freqs.push_back(freq);
+            }
+            position += docIDsSize + freqsSize;
+        }
+    }
+
+    if (!validList(entry, decodedDocIDs, freqs)) {
+        return fail(term);
+    }
+    docIDs.assign(decodedDocIDs.begin(), decodedDocIDs.end());
+    return true;
+}
+
+bool IndexScanner::fail(const std::string& term) {
+    std::cerr << "Error: Corrupt posting list for '" << term << "' in " << indexFilePath << std::endl;
+    corrupt = true;
+    return false;
+}
+
+// One freq per docID, as many as the lexicon says, and docIDs increasing within range
+bool IndexScanner::validList(const LexiconEntry& entry, const std::vector<std::int64_t>& docIDs,
+                             const std::vector<int>& freqs) const {
+    if (docIDs.size() != freqs.size() || docIDs.size() != static_cast<size_t>(entry.docFrequency)) {
+        return false;
+    }
+    for (size_t i = 0; i < docIDs.size(); ++i) {
+        if (docIDs[i] >= numDocs || (i > 0 && docIDs[i] <= docIDs[i - 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IndexScanner::readSize(size_t& value) {
+    if (listEnd - position < sizeof(size_t)) {
+        return false;
+    }
+    std::memcpy(&value, file.data() + position, sizeof(size_t));
+    position += sizeof(size_t);
+    return true;
+}
+
+int IndexScanner::decode(const std::uint8_t*& data, const std::uint8_t* end) {
+    std::int64_t number = 0;
+    int shift = 0;
+    while (data < end && shift <= 28) {
+        std::uint8_t byte = *data++;
+        number |= static_cast<std::int64_t>(byte & 0x7F) << shift;
+        if (byte & 0x80) {
+            return number <= INT_MAX ? static_cast<int>(number) : -1;
+        }
+        shift += 7;
+    }
+    return -1;
+}
@@ -0,0 +1,45 @@
+#ifndef INDEX_SCANNER_H
+#define INDEX_SCANNER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <climits>
+#include <fstream>
+#include "mapped_file.h"
+#include "lexicon.h"
+
+// Sequential reader over every posting list of a final index, in term order. The lexicon
+// drives the scan, since lists inlined in it have no bytes in the index file.
+class IndexScanner {
+public:
+    IndexScanner();
+
+    // Postings with docIDs of numDocs or more are treated as corruption
+    bool open(const std::string& indexFilePath, const std::string& lexiconFilePath, int numDocs = INT_MAX);
+
+    // Decode the next term's postings; returns false at the end of the index or on an
+    // error, which failed() tells apart
+    bool next(std::string& term, std::vector<int>& docIDs, std::vector<int>& freqs);
+    // True once a malformed lexicon entry or posting list was found
+    bool failed() const { return corrupt; }
+
+private:
+    MappedFile file;
+    std::ifstream lexicon;
+    std::string indexFilePath;
+    std::string lexiconFilePath;
+    int numDocs;
+    size_t position;
+    size_t listEnd;
+    bool corrupt;
+    std::vector<std::int64_t> decodedDocIDs;
+
+    bool fail(const std::string& term);
+    bool readSize(size_t& value);
+    bool validList(const LexiconEntry& entry, const std::vector<std::int64_t>& docIDs, const std::vector<int>& freqs) const;
+    // Returns -1 for a number that runs past end or does not fit in an int
+    static int decode(const std::uint8_t*& data, const std::uint8_t* end);
+};
+
+#endif // INDEX_SCANNER_H
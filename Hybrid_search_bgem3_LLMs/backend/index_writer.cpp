@@ -0,0 +1,295 @@
+#include "index_writer.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Variable-byte encoding function
+void varByteEncode(int number, std::vector<std::uint8_t>& encodedBytes) {
+    while (true) {
+        std::uint8_t byte = number & 0x7F;
+        number >>= 7;
+        if (number == 0) {
+            byte |= 0x80; // Set the continuation bit
+            encodedBytes.push_back(byte);
+            break;
+        } else {
+            encodedBytes.push_back(byte);
+        }
+    }
+}
+
+// AsyncFileWriter implementation
+AsyncFileWriter::AsyncFileWriter(size_t bufferSize)
+    : fd(-1), bufferSize(bufferSize), current(nullptr), currentSize(0), currentStart(0), stopping(false), failed(false) {
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    // Only an explicit close() publishes the file
+    if (is_open()) {
+        discard();
+    }
+}
+
+bool AsyncFileWriter::open(const std::string& filePath) {
+    this->filePath = filePath;
+    fd = ::open((filePath + ".tmp").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    // Page-aligned buffers keep pwrite on the kernel's fast path
+    for (int i = 0; i < NUM_BUFFERS; ++i) {
+        void* buffer = nullptr;
+        if (posix_memalign(&buffer, 4096, bufferSize) != 0) {
+            std::cerr << "Error: Unable to allocate write buffer for " << filePath << std::endl;
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        buffers.push_back(static_cast<std::uint8_t*>(buffer));
+        freeBuffers.push_back(buffers.back());
+    }
+    current = freeBuffers.back();
+    freeBuffers.pop_back();
+    currentSize = 0;
+    currentStart = 0;
+    stopping = false;
+    failed = false;
+    writerThread = std::thread(&AsyncFileWriter::run, this);
+    return true;
+}
+
+void AsyncFileWriter::write(const void* data, size_t size) {
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+    while (size > 0) {
+        size_t chunk = std::min(size, bufferSize - currentSize);
+        std::memcpy(current + currentSize, bytes, chunk);
+        currentSize += chunk;
+        bytes += chunk;
+        size -= chunk;
+        if (currentSize == bufferSize) {
+            submitCurrent();
+        }
+    }
+}
+
+void AsyncFileWriter::patch(int64_t offset, const void* data, size_t size) {
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+
+    // The part that has already been handed to the writer thread becomes a patch job
+    if (offset < currentStart) {
+        size_t handedOff = std::min(size, static_cast<size_t>(currentStart - offset));
+        Job job;
+        job.buffer = nullptr;
+        job.offset = offset;
+        job.size = handedOff;
+        job.patchData.assign(bytes, bytes + handedOff);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        jobReady.notify_one();
+        offset += handedOff;
+        bytes += handedOff;
+        size -= handedOff;
+    }
+
+    // The rest is still in the current buffer
+    if (size > 0) {
+        std::memcpy(current + (offset - currentStart), bytes, size);
+    }
+}
+
+void AsyncFileWriter::submitCurrent() {
+    std::unique_lock<std::mutex> lock(mutex);
+    Job job;
+    job.buffer = current;
+    job.offset = currentStart;
+    job.size = currentSize;
+    jobs.push_back(std::move(job));
+    jobReady.notify_one();
+
+    currentStart += currentSize;
+    currentSize = 0;
+    bufferFree.wait(lock, [this]() { return !freeBuffers.empty(); });
+    current = freeBuffers.back();
+    freeBuffers.pop_back();
+}
+
+void AsyncFileWriter::run() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        const std::uint8_t* data = job.buffer != nullptr ? job.buffer : job.patchData.data();
+        size_t written = 0;
+        while (written < job.size) {
+            ssize_t result = ::pwrite(fd, data + written, job.size - written, job.offset + written);
+            if (result <= 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed = true;
+                break;
+            }
+            written += static_cast<size_t>(result);
+        }
+
+        if (job.buffer != nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeBuffers.push_back(job.buffer);
+            bufferFree.notify_one();
+        }
+    }
+}
+
+bool AsyncFileWriter::close() {
+    if (currentSize > 0) {
+        submitCurrent();
+    }
+    shutdown();
+
+    if (failed || std::rename((filePath + ".tmp").c_str(), filePath.c_str()) != 0) {
+        std::cerr << "Error: Failed writing to " << filePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void AsyncFileWriter::discard() {
+    currentSize = 0;
+    shutdown();
+    std::remove((filePath + ".tmp").c_str());
+}
+
+void AsyncFileWriter::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_one();
+    writerThread.join();
+
+    ::close(fd);
+    fd = -1;
+    for (std::uint8_t* buffer : buffers) {
+        free(buffer);
+    }
+    buffers.clear();
+    freeBuffers.clear();
+    current = nullptr;
+}
+
+void writeLexiconEntry(AsyncFileWriter& lexiconOut, const std::string& term, const LexiconEntry& entry) {
+    thread_local std::string line;
+    line.clear();
+    formatLexiconEntry(term, entry, line);
+    line += '\n';
+    lexiconOut.write(line.data(), line.size());
+}
+
+// PostingListWriter implementation
+PostingListWriter::PostingListWriter(AsyncFileWriter& outFile, AsyncFileWriter& lexiconOut)
+    : outFile(outFile), lexiconOut(lexiconOut), headerWritten(false), termStartOffset(0), numBlocksOffset(0), numBlocks(0),
+      docFrequency(0), blockPostings(0) {
+}
+
+void PostingListWriter::beginTerm(const std::string& term) {
+    this->term = term;
+    headerWritten = false;
+    numBlocks = 0;
+    docFrequency = 0;
+    blockPostings = 0;
+}
+
+void PostingListWriter::writeHeader() {
+    termStartOffset = outFile.tell();
+    headerWritten = true;
+
+    // Write term size and term
+    size_t termSize = term.size();
+    outFile.write(&termSize, sizeof(size_t));
+    outFile.write(term.c_str(), termSize);
+
+    // Reserve the number of blocks; it is patched by endTerm
+    numBlocksOffset = outFile.tell();
+    outFile.write(&numBlocks, sizeof(size_t));
+}
+
+void PostingListWriter::addPosting(int docID, int freq) {
+    blockDocIDs[blockPostings] = docID;
+    blockFreqs[blockPostings] = freq;
+    blockPostings++;
+    docFrequency++;
+    if (blockPostings == BLOCK_SIZE) {
+        encodeBlock();
+        writeBlock();
+    }
+}
+
+void PostingListWriter::endTerm() {
+    LexiconEntry entry;
+    entry.docFrequency = docFrequency;
+    if (blockPostings > 0) {
+        encodeBlock();
+        size_t inlineSize = encodedDocIDs.size() + encodedFreqs.size();
+        if (!headerWritten && inlineSize <= static_cast<size_t>(LEXICON_INLINE_BYTES)) {
+            entry.offset = LEXICON_INLINED;
+            entry.length = static_cast<int32_t>(inlineSize);
+            std::copy(encodedDocIDs.begin(), encodedDocIDs.end(), entry.inlinePostings);
+            std::copy(encodedFreqs.begin(), encodedFreqs.end(), entry.inlinePostings + encodedDocIDs.size());
+            writeLexiconEntry(lexiconOut, term, entry);
+            return;
+        }
+        writeBlock();
+    }
+    if (!headerWritten) {
+        writeHeader();
+    }
+    outFile.patch(numBlocksOffset, &numBlocks, sizeof(size_t));
+
+    // Update lexicon with term, offset, length, docFrequency
+    entry.offset = termStartOffset;
+    entry.length = static_cast<int32_t>(outFile.tell() - termStartOffset);
+    writeLexiconEntry(lexiconOut, term, entry);
+}
+
+void PostingListWriter::encodeBlock() {
+    // Delta encode docIDs within block and compress docIDs and freqs separately
+    encodedDocIDs.clear();
+    encodedFreqs.clear();
+    varByteEncode(blockDocIDs[0], encodedDocIDs);
+    for (int i = 1; i < blockPostings; ++i) {
+        varByteEncode(blockDocIDs[i] - blockDocIDs[i - 1], encodedDocIDs);
+    }
+    for (int i = 0; i < blockPostings; ++i) {
+        varByteEncode(blockFreqs[i], encodedFreqs);
+    }
+}
+
+void PostingListWriter::writeBlock() {
+    if (!headerWritten) {
+        writeHeader();
+    }
+
+    // Write sizes of docIDs and freqs blocks, then the compressed blocks
+    size_t docIDsSize = encodedDocIDs.size();
+    size_t freqsSize = encodedFreqs.size();
+    outFile.write(&docIDsSize, sizeof(size_t));
+    outFile.write(&freqsSize, sizeof(size_t));
+    outFile.write(encodedDocIDs.data(), docIDsSize);
+    outFile.write(encodedFreqs.data(), freqsSize);
+
+    numBlocks++;
+    blockPostings = 0;
+}
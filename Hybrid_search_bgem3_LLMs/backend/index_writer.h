@@ -0,0 +1,119 @@
+#ifndef INDEX_WRITER_H
+#define INDEX_WRITER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "lexicon.h"
+
+// Number of postings per compressed block in the final index
+const int BLOCK_SIZE = 128;
+
+// Variable-byte encoding function
+void varByteEncode(int number, std::vector<std::uint8_t>& encodedBytes);
+
+// Sequential file writer that assembles aligned multi-megabyte buffers and hands them
+// to a background thread, which writes them with pwrite at offsets tracked in memory.
+// Bytes already handed off can still be overwritten with patch(); patches are queued
+// behind the buffers that contain them. The data goes to filePath.tmp, which close()
+// renames over filePath, so a server that has the old file mapped keeps reading it intact.
+// A writer destroyed without close() deletes filePath.tmp, so an early return on an error
+// never publishes a partial file.
+class AsyncFileWriter {
+public:
+    static const size_t DEFAULT_BUFFER_SIZE = static_cast<size_t>(4) << 20;
+    static const int NUM_BUFFERS = 4;
+
+    explicit AsyncFileWriter(size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    ~AsyncFileWriter();
+
+    bool open(const std::string& filePath);
+    bool is_open() const { return fd >= 0; }
+    void write(const void* data, size_t size);
+    void patch(int64_t offset, const void* data, size_t size);
+    int64_t tell() const { return currentStart + currentSize; }
+    // Flush everything, close the file and move it into place; returns false if any write failed
+    bool close();
+    // Stop writing and delete the partial file, leaving any existing filePath untouched
+    void discard();
+
+private:
+    struct Job {
+        std::uint8_t* buffer;           // Buffer to recycle after writing, or null for a patch
+        int64_t offset;
+        size_t size;
+        std::vector<std::uint8_t> patchData;
+    };
+
+    int fd;
+    std::string filePath;
+    size_t bufferSize;
+    std::vector<std::uint8_t*> buffers;
+    std::uint8_t* current;
+    size_t currentSize;
+    int64_t currentStart;               // File offset of current[0]
+
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable bufferFree;
+    std::deque<Job> jobs;
+    std::vector<std::uint8_t*> freeBuffers;
+    bool stopping;
+    bool failed;
+    std::thread writerThread;
+
+    void submitCurrent();
+    void run();
+    // Drain the queued jobs, stop the writer thread and release the file and buffers
+    void shutdown();
+};
+
+// Append one line to a lexicon (see lexicon.h)
+void writeLexiconEntry(AsyncFileWriter& lexiconOut, const std::string& term, const LexiconEntry& entry);
+
+// Streams posting lists into the final index format and appends their lexicon entries.
+// Shared by the merger and by the parser's in-memory indexing mode so both produce
+// byte-identical index files.
+//
+// Each block of BLOCK_SIZE postings is encoded as soon as it fills, and scratch buffers
+// are reused across blocks and terms. A term's header is written with its first block,
+// so a list that ends within LEXICON_INLINE_BYTES is inlined in the lexicon instead and
+// leaves no trace in the index. The block count in the header is written as a
+// placeholder and patched once the term ends.
+class PostingListWriter {
+public:
+    PostingListWriter(AsyncFileWriter& outFile, AsyncFileWriter& lexiconOut);
+
+    void beginTerm(const std::string& term);
+    void addPosting(int docID, int freq);
+    void endTerm();
+
+private:
+    AsyncFileWriter& outFile;
+    AsyncFileWriter& lexiconOut;
+
+    std::string term;
+    bool headerWritten;
+    int64_t termStartOffset;
+    int64_t numBlocksOffset;       // Offset of the term's block count field
+    size_t numBlocks;
+    int docFrequency;
+
+    int blockDocIDs[BLOCK_SIZE];
+    int blockFreqs[BLOCK_SIZE];
+    int blockPostings;
+
+    std::vector<std::uint8_t> encodedDocIDs;
+    std::vector<std::uint8_t> encodedFreqs;
+
+    void writeHeader();
+    // Encode the buffered postings into encodedDocIDs and encodedFreqs
+    void encodeBlock();
+    void writeBlock();
+};
+
+#endif // INDEX_WRITER_H
@@ -0,0 +1,125 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <csignal>
+#include <cstdint>
+#include <string_view>
+#include "segments.h"
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void onSignal(int) {
+    interrupted = 1;
+}
+
+// Add the passages of a TSV file (same format as collection.tsv) to the existing index as
+// incremental segments. With --follow the file is tailed like tail -f: appended lines are
+// indexed as they arrive and become searchable within the flush interval.
+int main(int argc, char* argv[]) {
+    std::string inputFilePath;
+    bool follow = false;
+    SegmentOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 8, "--input=") == 0) {
+            inputFilePath = arg.substr(8);
+        } else if (arg == "--follow") {
+            follow = true;
+        } else if (arg.compare(0, 13, "--flush-docs=") == 0) {
+            options.flushDocs = std::stoi(arg.substr(13));
+        } else if (arg.compare(0, 11, "--flush-ms=") == 0) {
+            options.flushIntervalMs = std::stoi(arg.substr(11));
+        } else if (arg.compare(0, 15, "--merge-factor=") == 0) {
+            options.mergeFactor = std::stoi(arg.substr(15));
+        } else if (arg.compare(0, 12, "--retire-ms=") == 0) {
+            options.retireDelayMs = std::stoi(arg.substr(12));
+        } else {
+            inputFilePath.clear();
+            break;
+        }
+    }
+    if (inputFilePath.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --input=FILE [--follow] [--flush-docs=N] [--flush-ms=N]"
+                  << " [--merge-factor=N] [--retire-ms=N]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream inFile(inputFilePath, std::ios::binary);
+    if (!inFile.is_open()) {
+        std::cerr << "Error opening file: " << inputFilePath << std::endl;
+        return 1;
+    }
+
+    SegmentManager manager(options);
+    if (!manager.open()) {
+        return 1;
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    SegmentBuilder builder(manager.textAnalysis());
+    auto oldestPending = std::chrono::steady_clock::now();
+    int totalDocs = 0;
+    auto addLine = [&](const std::string& line, std::uint64_t lineOffset) {
+        // Split "passageID<TAB>passageText[<TAB>...]"
+        std::string_view view(line);
+        size_t idEnd = view.find('\t');
+        std::string_view passageText;
+        if (idEnd != std::string_view::npos) {
+            passageText = view.substr(idEnd + 1);
+            passageText = passageText.substr(0, passageText.find('\t'));
+        }
+        if (builder.numDocs() == 0) {
+            oldestPending = std::chrono::steady_clock::now();
+        }
+        builder.addDocument(view.substr(0, idEnd), passageText, lineOffset);
+        totalDocs++;
+    };
+
+    std::uint64_t offset = 0;
+    std::string line;
+    std::string partialLine;
+    bool ok = true;
+    while (!interrupted && ok) {
+        if (std::getline(inFile, line)) {
+            if (!inFile.eof()) {
+                // A complete line; when tailing, its start may have arrived earlier
+                line = partialLine + line;
+                partialLine.clear();
+                addLine(line, offset);
+                offset += line.size() + 1;
+                if (builder.numDocs() >= options.flushDocs) {
+                    ok = manager.flush(builder);
+                }
+                continue;
+            }
+            // No newline yet: a line still being written, or the file's last line
+            partialLine += line;
+            if (!follow) {
+                addLine(partialLine, offset);
+                break;
+            }
+        } else if (!follow) {
+            break;
+        }
+
+        // Wait for more input, flushing documents that have waited long enough
+        inFile.clear();
+        if (builder.numDocs() > 0 &&
+            std::chrono::steady_clock::now() - oldestPending >= std::chrono::milliseconds(options.flushIntervalMs)) {
+            ok = manager.flush(builder);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    if (ok) {
+        ok = manager.flush(builder);
+    }
+    manager.close();
+    std::cout << "[INFO] Indexed " << totalDocs << " documents." << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+#include "lexicon.h"
+#include <cstdio>
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+bool readLexiconEntry(std::istream& in, std::string& term, LexiconEntry& entry) {
+    if (!(in >> term >> entry.offset >> entry.length >> entry.docFrequency)) {
+        return false;
+    }
+    if (!entry.inlined()) {
+        return true;
+    }
+
+    std::string hex;
+    if (!(in >> hex) || entry.length < 0 || entry.length > LEXICON_INLINE_BYTES ||
+        hex.size() != 2 * static_cast<size_t>(entry.length)) {
+        return false;
+    }
+    for (int i = 0; i < entry.length; ++i) {
+        int high = hexValue(hex[2 * i]);
+        int low = hexValue(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        entry.inlinePostings[i] = static_cast<std::uint8_t>(high << 4 | low);
+    }
+    return true;
+}
+
+void formatLexiconEntry(const std::string& term, const LexiconEntry& entry, std::string& line) {
+    char numbers[64];
+    int numbersSize = std::snprintf(numbers, sizeof(numbers), " %lld %d %d", static_cast<long long>(entry.offset),
+                                    entry.length, entry.docFrequency);
+    line += term;
+    line.append(numbers, numbersSize);
+    if (entry.inlined()) {
+        static const char DIGITS[] = "0123456789abcdef";
+        line += ' ';
+        for (int i = 0; i < entry.length; ++i) {
+            line += DIGITS[entry.inlinePostings[i] >> 4];
+            line += DIGITS[entry.inlinePostings[i] & 0xF];
+        }
+    }
+}
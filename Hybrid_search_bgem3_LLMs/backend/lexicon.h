@@ -0,0 +1,35 @@
+#ifndef LEXICON_H
+#define LEXICON_H
+
+#include <string>
+#include <istream>
+#include <cstdint>
+
+// Text lexicon written next to the final index, one line per term in index order:
+//   term offset length docFrequency
+// where offset and length locate the term's list in the index file. Most terms occur in
+// only a few documents, and their whole list (variable-byte docIDs, the first absolute
+// and the rest gaps, followed by the freqs) takes fewer bytes than the list header alone.
+// Such lists are inlined instead: they get no bytes in the index file and the line reads
+//   term -1 length docFrequency hexBytes
+// with the encoded postings in hex, so opening the list needs no index access.
+
+// Lists whose encoded postings fit in this many bytes are inlined
+const int LEXICON_INLINE_BYTES = 8;
+const int64_t LEXICON_INLINED = -1;
+
+struct LexiconEntry {
+    int64_t offset;         // LEXICON_INLINED when the postings are in inlinePostings
+    int32_t length;         // Bytes of the list in the index file, or of inlinePostings
+    int docFrequency;
+    std::uint8_t inlinePostings[LEXICON_INLINE_BYTES];
+
+    bool inlined() const { return offset == LEXICON_INLINED; }
+};
+
+// Read the next line; returns false at the end of the lexicon or on a malformed line
+bool readLexiconEntry(std::istream& in, std::string& term, LexiconEntry& entry);
+// Append one line, without the trailing newline, to line
+void formatLexiconEntry(const std::string& term, const LexiconEntry& entry, std::string& line);
+
+#endif // LEXICON_H
@@ -0,0 +1,67 @@
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile() : fd(-1), base(nullptr), length(0) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& filePath, bool sequential) {
+    close();
+    fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(fileStat.st_size);
+    if (length == 0) {
+        // Nothing to map; an empty file is still a valid, empty view
+        return true;
+    }
+
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close();
+        return false;
+    }
+    base = static_cast<const char*>(mapping);
+    if (sequential) {
+        madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+    return true;
+}
+
+void MappedFile::warm() const {
+    if (base == nullptr) {
+        return;
+    }
+    madvise(const_cast<char*>(base), length, MADV_WILLNEED);
+    // Touch one byte per page; the volatile sum keeps the loads from being optimized away
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    volatile unsigned char sum = 0;
+    for (size_t offset = 0; offset < length; offset += pageSize) {
+        sum += static_cast<unsigned char>(base[offset]);
+    }
+}
+
+void MappedFile::close() {
+    if (base != nullptr) {
+        munmap(const_cast<char*>(base), length);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+    base = nullptr;
+    length = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map a file; sequential hints the kernel to read ahead aggressively
+    bool open(const std::string& filePath, bool sequential = false);
+    void close();
+
+    bool is_open() const { return fd >= 0; }
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+    // Read the whole mapping into the page cache and fault in every page
+    void warm() const;
+
+private:
+    int fd;
+    const char* base;
+    size_t length;
+};
+
+#endif // MAPPED_FILE_H
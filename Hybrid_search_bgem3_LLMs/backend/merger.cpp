@@ -2,255 +2,614 @@
 #include <fstream>
 #include <vector>
 #include <string>
-#include <sstream>
-#include <queue>
-#include <functional>
-#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
 #include <cstdint>
-
-// Define the Posting struct
-struct Posting {
+#include <thread>
+#include <atomic>
+#include <sys/resource.h>
+#include "merger.h"
+#include "index_writer.h"
+
+// Default read buffer size for each run cursor
+const size_t RUN_BUFFER_SIZE = 1 << 20;
+// Terms sampled per run when choosing term-range split points
+const int SAMPLES_PER_RUN = 64;
+
+// Buffered cursor over one temporary run file ("term docID freq" lines sorted by term
+// and docID). The run is exposed one term at a time: the current term together with
+// all of its postings in this run, so the merge compares terms once per group rather
+// than once per posting.
+class RunCursor {
+public:
     std::string term;
-    int docID;
-    int freq;
-    int fileIndex; // Index of the file this posting came from
+    std::vector<int> docIDs;
+    std::vector<int> freqs;
+    bool exhausted;
+
+    RunCursor() : exhausted(true), pos(0), end(0), eof(false), hasPending(false) {}
+
+    // Open a run, optionally starting at a line offset and stopping before endTerm. A run
+    // with no terms in the range opens already exhausted; only I/O errors return false.
+    bool open(const std::string& fileName, size_t bufferSize, int64_t startOffset = 0, const std::string& endTerm = "") {
+        in.open(fileName, std::ios::binary);
+        if (!in.is_open()) {
+            return false;
+        }
+        in.seekg(startOffset);
+        this->endTerm = endTerm;
+        buffer.resize(bufferSize);
+        exhausted = false;
+        hasPending = readLine();
+        nextGroup();
+        return !in.bad();
+    }
+
+    // Load the next term group; returns false once the run is exhausted
+    bool nextGroup() {
+        docIDs.clear();
+        freqs.clear();
+        if (!hasPending) {
+            exhausted = true;
+            return false;
+        }
+        term.assign(pendingTerm, pendingTermSize);
+        docIDs.push_back(pendingDocID);
+        freqs.push_back(pendingFreq);
+        while ((hasPending = readLine()) && term.compare(0, std::string::npos, pendingTerm, pendingTermSize) == 0) {
+            docIDs.push_back(pendingDocID);
+            freqs.push_back(pendingFreq);
+        }
+        return true;
+    }
+
+private:
+    std::ifstream in;
+    std::vector<char> buffer;
+    size_t pos;
+    size_t end;
+    bool eof;
+    std::string endTerm;
+
+    // Most recently parsed line; the term points into the read buffer
+    bool hasPending;
+    const char* pendingTerm;
+    size_t pendingTermSize;
+    int pendingDocID;
+    int pendingFreq;
+
+    void refill() {
+        // Move the unread tail to the front, growing the buffer if one line fills it
+        size_t remaining = end - pos;
+        std::memmove(buffer.data(), buffer.data() + pos, remaining);
+        if (remaining == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+        pos = 0;
+        end = remaining;
+        in.read(buffer.data() + end, buffer.size() - end);
+        std::streamsize bytesRead = in.gcount();
+        if (bytesRead <= 0) {
+            eof = true;
+        }
+        end += static_cast<size_t>(bytesRead);
+    }
+
+    static int parseInt(const char*& p, const char* limit) {
+        while (p < limit && *p == ' ') {
+            ++p;
+        }
+        int value = 0;
+        while (p < limit && *p >= '0' && *p <= '9') {
+            value = value * 10 + (*p - '0');
+            ++p;
+        }
+        return value;
+    }
 
-    // Constructor
-    Posting(const std::string& t, int d, int f, int idx) : term(t), docID(d), freq(f), fileIndex(idx) {}
+    bool readLine() {
+        while (true) {
+            const char* begin = buffer.data() + pos;
+            const char* limit = buffer.data() + end;
+            const char* newline = static_cast<const char*>(std::memchr(begin, '\n', limit - begin));
+            if (newline == nullptr) {
+                if (!eof) {
+                    refill();
+                    continue;
+                }
+                if (begin == limit) {
+                    return false;
+                }
+                newline = limit; // Last line without a trailing newline
+            }
+
+            const char* p = begin;
+            while (p < newline && *p != ' ') {
+                ++p;
+            }
+            pendingTerm = begin;
+            pendingTermSize = p - begin;
+            if (!endTerm.empty() && endTerm.compare(0, std::string::npos, pendingTerm, pendingTermSize) <= 0) {
+                // Reached the end of this cursor's term range
+                eof = true;
+                pos = end;
+                return false;
+            }
+            pendingDocID = parseInt(p, newline);
+            pendingFreq = parseInt(p, newline);
+            pos = std::min(static_cast<size_t>(newline - buffer.data()) + 1, end);
+            return true;
+        }
+    }
 };
 
-// Comparator for the priority queue (min-heap)
-struct PostingComparator {
-    bool operator()(const Posting& a, const Posting& b) {
-        if (a.term == b.term) {
-            return a.docID > b.docID; // For the same term, order by docID
+// Tournament (loser) tree over run cursors. Internal nodes hold the loser of each
+// match and tree[0] the overall winner, so replacing the winner's group costs one
+// comparison per level instead of a heap sift with string copies.
+class LoserTree {
+public:
+    explicit LoserTree(std::vector<RunCursor>& cursors) : cursors(cursors), k(cursors.size()), tree(cursors.size(), -1) {
+        for (int i = k - 1; i >= 0; --i) {
+            replay(i);
+        }
+    }
+
+    int winner() const {
+        return tree[0];
+    }
+
+    // Replay the matches from a leaf whose cursor has advanced
+    void replay(int leaf) {
+        int winner = leaf;
+        for (int node = (leaf + k) / 2; node > 0; node /= 2) {
+            if (tree[node] == -1) {
+                // Still building: park here until the sibling subtree arrives
+                tree[node] = winner;
+                return;
+            }
+            if (beats(tree[node], winner)) {
+                std::swap(tree[node], winner);
+            }
+        }
+        tree[0] = winner;
+    }
+
+private:
+    std::vector<RunCursor>& cursors;
+    int k;
+    std::vector<int> tree;
+
+    // Order groups by term, then by first docID (runs cover increasing docID ranges)
+    bool beats(int a, int b) const {
+        const RunCursor& x = cursors[a];
+        const RunCursor& y = cursors[b];
+        if (x.exhausted || y.exhausted) {
+            return !x.exhausted;
         }
-        return a.term > b.term; // Order by term
+        int cmp = x.term.compare(y.term);
+        if (cmp != 0) {
+            return cmp < 0;
+        }
+        return x.docIDs[0] < y.docIDs[0];
     }
 };
 
-// Variable-byte encoding function
-void varByteEncode(int number, std::vector<std::uint8_t>& encodedBytes) {
-    while (true) {
-        std::uint8_t byte = number & 0x7F;
-        number >>= 7;
-        if (number == 0) {
-            byte |= 0x80; // Set the continuation bit
-            encodedBytes.push_back(byte);
-            break;
+// Function to read the term of the first line starting at or after an offset of a run.
+// Returns false if there is no such line.
+bool readTermAtOrAfter(std::ifstream& in, int64_t offset, std::string& term, int64_t& lineStart) {
+    in.clear();
+    std::string line;
+    if (offset > 0) {
+        // Skip the rest of the line containing offset - 1
+        in.seekg(offset - 1);
+        std::getline(in, line);
+    } else {
+        in.seekg(0);
+    }
+    lineStart = in.tellg();
+    if (!std::getline(in, line)) {
+        return false;
+    }
+    term = line.substr(0, line.find(' '));
+    return true;
+}
+
+// Function to find the offset of the first line of a run whose term is >= target
+// by binary search over byte offsets. Returns -1 if the run cannot be opened.
+int64_t findTermOffset(const std::string& fileName, const std::string& target) {
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in.is_open()) {
+        return -1;
+    }
+    in.seekg(0, std::ios::end);
+    int64_t low = 0;
+    int64_t high = in.tellg();
+    std::string term;
+    int64_t lineStart;
+    while (low < high) {
+        int64_t mid = low + (high - low) / 2;
+        if (readTermAtOrAfter(in, mid, term, lineStart) && term < target) {
+            low = mid + 1;
         } else {
-            encodedBytes.push_back(byte);
+            high = mid;
         }
     }
+    if (!readTermAtOrAfter(in, low, term, lineStart)) {
+        in.clear();
+        in.seekg(0, std::ios::end);
+        return in.tellg();
+    }
+    return lineStart;
 }
 
-// Function to perform I/O-efficient multi-way merge and generate the final inverted index
-void mergeInvertedIndexes(const std::vector<std::string>& indexFiles, const std::string& outputIndexFile, const std::string& outputLexiconFile) {
-    // Open all temporary posting files
-    int numFiles = indexFiles.size();
-    std::vector<std::ifstream> inputFiles(numFiles);
-    for (int i = 0; i < numFiles; ++i) {
-        inputFiles[i].open(indexFiles[i]);
-        if (!inputFiles[i].is_open()) {
+// Merge the term groups of the given run cursors into an index and lexicon
+void mergeRuns(std::vector<RunCursor>& cursors, AsyncFileWriter& outFile, AsyncFileWriter& lexiconOut) {
+    if (cursors.empty()) {
+        return;
+    }
+
+    PostingListWriter writer(outFile, lexiconOut);
+    std::string currentTerm = "";
+
+    // Perform the multi-way merge, one term group at a time
+    LoserTree loserTree(cursors);
+    while (!cursors[loserTree.winner()].exhausted) {
+        int runIdx = loserTree.winner();
+        RunCursor& cursor = cursors[runIdx];
+
+        // Check if we have moved to a new term
+        if (currentTerm != cursor.term) {
+            // If not the first term, finish the previous term's list
+            if (!currentTerm.empty()) {
+                writer.endTerm();
+            }
+            currentTerm = cursor.term;
+            writer.beginTerm(currentTerm);
+        }
+
+        // Stream this run's postings for the term into the writer
+        for (size_t i = 0; i < cursor.docIDs.size(); ++i) {
+            writer.addPosting(cursor.docIDs[i], cursor.freqs[i]);
+        }
+
+        // Advance the run to its next term group and replay its matches
+        cursor.nextGroup();
+        loserTree.replay(runIdx);
+    }
+
+    // Finish the last term's list
+    if (!currentTerm.empty()) {
+        writer.endTerm();
+    }
+}
+
+// Merge a group of runs into one intermediate run in the same text format
+bool mergeRunsToRun(const std::vector<std::string>& indexFiles, const std::string& outputRunFile, size_t readBufferSize) {
+    std::vector<RunCursor> cursors(indexFiles.size());
+    for (size_t i = 0; i < indexFiles.size(); ++i) {
+        if (!cursors[i].open(indexFiles[i], readBufferSize)) {
             std::cerr << "Error opening file: " << indexFiles[i] << std::endl;
-            return;
+            return false;
         }
     }
 
-    // Initialize priority queue (min-heap)
-    std::priority_queue<Posting, std::vector<Posting>, PostingComparator> pq;
+    // Give the output the same large buffer as each input so writes stay sequential
+    std::vector<char> writeBuffer(readBufferSize);
+    std::ofstream outFile;
+    outFile.rdbuf()->pubsetbuf(writeBuffer.data(), writeBuffer.size());
+    outFile.open(outputRunFile, std::ios::binary);
+    if (!outFile.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << outputRunFile << std::endl;
+        return false;
+    }
 
-    // Read the first posting from each file and add it to the priority queue
+    LoserTree loserTree(cursors);
+    while (!cursors[loserTree.winner()].exhausted) {
+        int runIdx = loserTree.winner();
+        RunCursor& cursor = cursors[runIdx];
+        for (size_t i = 0; i < cursor.docIDs.size(); ++i) {
+            outFile << cursor.term << " " << cursor.docIDs[i] << " " << cursor.freqs[i] << "\n";
+        }
+        cursor.nextGroup();
+        loserTree.replay(runIdx);
+    }
+    outFile.close();
+    if (!outFile) {
+        std::cerr << "Error: Failed writing to " << outputRunFile << std::endl;
+        std::remove(outputRunFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Merge the part of every run whose terms fall in [startTerm, endTerm) into one index
+// segment. An empty startTerm or endTerm leaves that side of the range open.
+bool mergeTermRange(const std::vector<std::string>& indexFiles, const std::string& startTerm, const std::string& endTerm,
+                    const std::string& outputIndexFile, const std::string& outputLexiconFile, size_t readBufferSize) {
+    // Open all temporary posting files, positioned at the start of the range
+    int numFiles = indexFiles.size();
+    std::vector<RunCursor> cursors(numFiles);
     for (int i = 0; i < numFiles; ++i) {
-        std::string line;
-        if (std::getline(inputFiles[i], line)) {
-            std::istringstream iss(line);
-            std::string term;
-            int docID;
-            int freq;
-            iss >> term >> docID >> freq;
-            pq.emplace(term, docID, freq, i);
+        int64_t startOffset = startTerm.empty() ? 0 : findTermOffset(indexFiles[i], startTerm);
+        if (startOffset < 0 || !cursors[i].open(indexFiles[i], readBufferSize, startOffset, endTerm)) {
+            std::cerr << "Error opening file: " << indexFiles[i] << std::endl;
+            return false;
         }
     }
 
     // Prepare output files
-    std::ofstream outFile(outputIndexFile, std::ios::binary);
-    if (!outFile.is_open()) {
+    AsyncFileWriter outFile;
+    if (!outFile.open(outputIndexFile)) {
         std::cerr << "Error: Unable to open output file for writing: " << outputIndexFile << std::endl;
-        return;
+        return false;
     }
-    std::ofstream lexiconOut(outputLexiconFile);
-    if (!lexiconOut.is_open()) {
+    AsyncFileWriter lexiconOut;
+    if (!lexiconOut.open(outputLexiconFile)) {
         std::cerr << "Error: Unable to open lexicon file for writing: " << outputLexiconFile << std::endl;
-        return;
+        outFile.discard();
+        return false;
     }
-    int64_t currentOffset = 0;
 
-    // Variables to store postings for the current term
-    std::string currentTerm = "";
-    std::vector<int> docIDs;
-    std::vector<int> freqs;
+    mergeRuns(cursors, outFile, lexiconOut);
 
-    // Block variables
-    const int BLOCK_SIZE = 128; // Adjust as needed
+    // Close all files; a lexicon is only moved into place together with its index
+    if (!outFile.close()) {
+        lexiconOut.discard();
+        return false;
+    }
+    return lexiconOut.close();
+}
 
-    // Perform the multi-way merge
-    while (!pq.empty()) {
-        Posting topPosting = pq.top();
-        pq.pop();
+// Function to perform I/O-efficient multi-way merge and generate the final inverted index
+bool mergeInvertedIndexes(const std::vector<std::string>& indexFiles, const std::string& outputIndexFile, const std::string& outputLexiconFile) {
+    if (!mergeTermRange(indexFiles, "", "", outputIndexFile, outputLexiconFile, RUN_BUFFER_SIZE)) {
+        return false;
+    }
+    std::cout << "[INFO] Merged inverted index and lexicon generated successfully." << std::endl;
+    return true;
+}
 
-        // Check if we have moved to a new term
-        if (currentTerm != topPosting.term) {
-            // If not the first term, write the previous term's postings to disk
-            if (!currentTerm.empty()) {
-                // Write postings for the previous term
-                // Split postings into blocks
-                size_t numBlocks = (docIDs.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
-                size_t termStartOffset = outFile.tellp();
-
-                // Write term size and term
-                size_t termSize = currentTerm.size();
-                outFile.write(reinterpret_cast<const char*>(&termSize), sizeof(size_t));
-                outFile.write(currentTerm.c_str(), termSize);
-
-                // Write number of blocks
-                outFile.write(reinterpret_cast<const char*>(&numBlocks), sizeof(size_t));
-
-                // For each block
-                for (size_t blockIndex = 0; blockIndex < numBlocks; ++blockIndex) {
-                    size_t start = blockIndex * BLOCK_SIZE;
-                    size_t end = std::min(start + BLOCK_SIZE, docIDs.size());
-
-                    // Extract block postings
-                    std::vector<int> blockDocIDs(docIDs.begin() + start, docIDs.begin() + end);
-                    std::vector<int> blockFreqs(freqs.begin() + start, freqs.begin() + end);
-
-                    // Delta encode docIDs within block
-                    std::vector<int> deltaDocIDs(blockDocIDs.size());
-                    deltaDocIDs[0] = blockDocIDs[0];
-                    for (size_t i = 1; i < blockDocIDs.size(); ++i) {
-                        deltaDocIDs[i] = blockDocIDs[i] - blockDocIDs[i - 1];
-                    }
-
-                    // Compress docIDs and freqs separately
-                    std::vector<std::uint8_t> encodedDocIDs;
-                    for (int deltaDocID : deltaDocIDs) {
-                        varByteEncode(deltaDocID, encodedDocIDs);
-                    }
-
-                    std::vector<std::uint8_t> encodedFreqs;
-                    for (int freq : blockFreqs) {
-                        varByteEncode(freq, encodedFreqs);
-                    }
-
-                    // Write sizes of docIDs and freqs blocks
-                    size_t docIDsSize = encodedDocIDs.size();
-                    size_t freqsSize = encodedFreqs.size();
-                    outFile.write(reinterpret_cast<const char*>(&docIDsSize), sizeof(size_t));
-                    outFile.write(reinterpret_cast<const char*>(&freqsSize), sizeof(size_t));
-
-                    // Write the compressed blocks
-                    outFile.write(reinterpret_cast<const char*>(encodedDocIDs.data()), docIDsSize);
-                    outFile.write(reinterpret_cast<const char*>(encodedFreqs.data()), freqsSize);
-                }
+// Function to pick term-range split points by sampling the runs. Samples are taken
+// at evenly spaced byte offsets so each range gets a similar share of postings.
+std::vector<std::string> chooseSplitTerms(const std::vector<std::string>& indexFiles, int numPartitions) {
+    std::vector<std::string> samples;
+    for (const std::string& fileName : indexFiles) {
+        std::ifstream in(fileName, std::ios::binary);
+        in.seekg(0, std::ios::end);
+        int64_t fileSize = in.tellg();
+        std::string term;
+        for (int i = 0; i < SAMPLES_PER_RUN; ++i) {
+            int64_t lineStart;
+            if (readTermAtOrAfter(in, fileSize * i / SAMPLES_PER_RUN, term, lineStart)) {
+                samples.push_back(term);
+            }
+        }
+    }
+    std::sort(samples.begin(), samples.end());
 
-                // Update lexicon with term, offset, length, docFrequency
-                int64_t newOffset = outFile.tellp();
-                int32_t length = static_cast<int32_t>(newOffset - termStartOffset);
-                int docFrequency = docIDs.size();
+    std::vector<std::string> splitTerms;
+    if (samples.empty()) {
+        return splitTerms;
+    }
+    for (int i = 1; i < numPartitions; ++i) {
+        const std::string& split = samples[samples.size() * i / numPartitions];
+        if (!split.empty() && (splitTerms.empty() || splitTerms.back() < split)) {
+            splitTerms.push_back(split);
+        }
+    }
+    return splitTerms;
+}
 
-                lexiconOut << currentTerm << " " << termStartOffset << " " << length << " " << docFrequency << "\n";
+// Function to append a segment to the final index and its lexicon entries, shifted
+// by the segment's base offset (inlined lists have none), to the final lexicon
+bool appendSegment(const std::string& segmentIndexFile, const std::string& segmentLexiconFile, int64_t baseOffset,
+                   AsyncFileWriter& outFile, AsyncFileWriter& lexiconOut) {
+    std::ifstream segmentIn(segmentIndexFile, std::ios::binary);
+    std::ifstream segmentLexicon(segmentLexiconFile);
+    if (!segmentIn.is_open() || !segmentLexicon.is_open()) {
+        std::cerr << "Error opening index segment: " << segmentIndexFile << std::endl;
+        return false;
+    }
 
-                currentOffset = newOffset;
-                docIDs.clear();
-                freqs.clear();
-            }
+    std::vector<char> buffer(AsyncFileWriter::DEFAULT_BUFFER_SIZE);
+    while (segmentIn.read(buffer.data(), buffer.size()) || segmentIn.gcount() > 0) {
+        outFile.write(buffer.data(), segmentIn.gcount());
+    }
 
-            // Reset variables for the new term
-            currentTerm = topPosting.term;
+    std::string term;
+    LexiconEntry entry;
+    while (readLexiconEntry(segmentLexicon, term, entry)) {
+        if (!entry.inlined()) {
+            entry.offset += baseOffset;
         }
+        writeLexiconEntry(lexiconOut, term, entry);
+    }
+    return true;
+}
 
-        // Add the current posting to the term's posting list
-        docIDs.push_back(topPosting.docID);
-        freqs.push_back(topPosting.freq);
-
-        // Read the next posting from the same file and add it to the priority queue
-        int fileIdx = topPosting.fileIndex;
-        std::string line;
-        if (std::getline(inputFiles[fileIdx], line)) {
-            std::istringstream iss(line);
-            std::string term;
-            int docID;
-            int freq;
-            iss >> term >> docID >> freq;
-            pq.emplace(term, docID, freq, fileIdx);
+// Function to merge the runs on several threads, one term range per thread, and stitch
+// the resulting segments into the same index and lexicon the serial merge produces.
+// On failure the existing outputs are left untouched.
+bool mergeInvertedIndexesParallel(const std::vector<std::string>& indexFiles, const std::string& outputIndexFile,
+                                  const std::string& outputLexiconFile, int numThreads, size_t readBufferSize) {
+    std::vector<std::string> splitTerms;
+    if (numThreads > 1 && !indexFiles.empty()) {
+        splitTerms = chooseSplitTerms(indexFiles, numThreads);
+    }
+    if (splitTerms.empty()) {
+        if (!mergeTermRange(indexFiles, "", "", outputIndexFile, outputLexiconFile, readBufferSize)) {
+            return false;
         }
+        std::cout << "[INFO] Merged inverted index and lexicon generated successfully." << std::endl;
+        return true;
     }
 
-    // Write postings for the last term
-    if (!currentTerm.empty()) {
-        // Similar to above, write the last term's postings
-        size_t numBlocks = (docIDs.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
-        size_t termStartOffset = outFile.tellp();
-
-        size_t termSize = currentTerm.size();
-        outFile.write(reinterpret_cast<const char*>(&termSize), sizeof(size_t));
-        outFile.write(currentTerm.c_str(), termSize);
-
-        // Write number of blocks
-        outFile.write(reinterpret_cast<const char*>(&numBlocks), sizeof(size_t));
-
-        // For each block
-        for (size_t blockIndex = 0; blockIndex < numBlocks; ++blockIndex) {
-            size_t start = blockIndex * BLOCK_SIZE;
-            size_t end = std::min(start + BLOCK_SIZE, docIDs.size());
-
-            // Extract block postings
-            std::vector<int> blockDocIDs(docIDs.begin() + start, docIDs.begin() + end);
-            std::vector<int> blockFreqs(freqs.begin() + start, freqs.begin() + end);
-
-            // Delta encode docIDs within block
-            std::vector<int> deltaDocIDs(blockDocIDs.size());
-            deltaDocIDs[0] = blockDocIDs[0];
-            for (size_t i = 1; i < blockDocIDs.size(); ++i) {
-                deltaDocIDs[i] = blockDocIDs[i] - blockDocIDs[i - 1];
-            }
+    // Merge each term range into its own segment
+    int numPartitions = splitTerms.size() + 1;
+    std::vector<std::string> segmentIndexFiles(numPartitions);
+    std::vector<std::string> segmentLexiconFiles(numPartitions);
+    std::vector<char> succeeded(numPartitions, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numPartitions; ++i) {
+        segmentIndexFiles[i] = outputIndexFile + ".part" + std::to_string(i);
+        segmentLexiconFiles[i] = outputLexiconFile + ".part" + std::to_string(i);
+        std::string startTerm = (i == 0) ? "" : splitTerms[i - 1];
+        std::string endTerm = (i == numPartitions - 1) ? "" : splitTerms[i];
+        threads.emplace_back([&, i, startTerm, endTerm]() {
+            succeeded[i] = mergeTermRange(indexFiles, startTerm, endTerm, segmentIndexFiles[i], segmentLexiconFiles[i],
+                                          readBufferSize);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
 
-            // Compress docIDs and freqs separately
-            std::vector<std::uint8_t> encodedDocIDs;
-            for (int deltaDocID : deltaDocIDs) {
-                varByteEncode(deltaDocID, encodedDocIDs);
-            }
+    // Concatenate the segments and fix up lexicon offsets
+    bool ok = std::find(succeeded.begin(), succeeded.end(), 0) == succeeded.end();
+    AsyncFileWriter outFile;
+    AsyncFileWriter lexiconOut;
+    if (ok && (!outFile.open(outputIndexFile) || !lexiconOut.open(outputLexiconFile))) {
+        std::cerr << "Error: Unable to open output files for writing: " << outputIndexFile << std::endl;
+        ok = false;
+    }
+    int64_t baseOffset = 0;
+    for (int i = 0; i < numPartitions; ++i) {
+        if (ok) {
+            ok = appendSegment(segmentIndexFiles[i], segmentLexiconFiles[i], baseOffset, outFile, lexiconOut);
+            baseOffset = outFile.tell();
+        }
+        std::remove(segmentIndexFiles[i].c_str());
+        std::remove(segmentLexiconFiles[i].c_str());
+    }
+    // Only a complete index replaces the outputs, and the lexicon only with its index
+    if (ok && !outFile.close()) {
+        ok = false;
+    }
+    if (ok && !lexiconOut.close()) {
+        ok = false;
+    }
+    if (outFile.is_open()) {
+        outFile.discard();
+    }
+    if (lexiconOut.is_open()) {
+        lexiconOut.discard();
+    }
 
-            std::vector<std::uint8_t> encodedFreqs;
-            for (int freq : blockFreqs) {
-                varByteEncode(freq, encodedFreqs);
-            }
+    if (!ok) {
+        std::cerr << "Error: Parallel merge failed; " << outputIndexFile << " was not written." << std::endl;
+        return false;
+    }
+    std::cout << "[INFO] Merged inverted index and lexicon generated successfully (" << numPartitions
+              << " term ranges)." << std::endl;
+    return true;
+}
 
-            // Write sizes of docIDs and freqs blocks
-            size_t docIDsSize = encodedDocIDs.size();
-            size_t freqsSize = encodedFreqs.size();
-            outFile.write(reinterpret_cast<const char*>(&docIDsSize), sizeof(size_t));
-            outFile.write(reinterpret_cast<const char*>(&freqsSize), sizeof(size_t));
+// Function to plan the merge fan-in from the run count, the memory budget for read
+// buffers and the open file limit. Returns the smallest fan-in that still needs the
+// minimum number of passes, which keeps the groups of each pass balanced.
+int planMergeFanIn(size_t numRuns, const MergeOptions& options, int& numPasses) {
+    size_t numThreads = std::max(1, options.numThreads);
+    size_t maxFanIn = options.memoryBudgetBytes / (options.readBufferSize * numThreads);
+
+    struct rlimit fileLimit;
+    if (getrlimit(RLIMIT_NOFILE, &fileLimit) == 0 && fileLimit.rlim_cur != RLIM_INFINITY) {
+        // Leave room for stdio, outputs and segment files
+        size_t usable = fileLimit.rlim_cur > 64 ? fileLimit.rlim_cur - 32 : fileLimit.rlim_cur / 2;
+        maxFanIn = std::min(maxFanIn, usable / numThreads);
+    }
+    if (options.fanIn > 0) {
+        maxFanIn = std::min(maxFanIn, static_cast<size_t>(options.fanIn));
+    }
+    maxFanIn = std::max(maxFanIn, static_cast<size_t>(2));
 
-            // Write the compressed blocks
-            outFile.write(reinterpret_cast<const char*>(encodedDocIDs.data()), docIDsSize);
-            outFile.write(reinterpret_cast<const char*>(encodedFreqs.data()), freqsSize);
+    numPasses = 1;
+    size_t reach = maxFanIn;
+    while (reach < numRuns) {
+        numPasses++;
+        reach *= maxFanIn;
+    }
+
+    size_t fanIn = 2;
+    while (true) {
+        size_t covered = 1;
+        for (int pass = 0; pass < numPasses && covered < numRuns; ++pass) {
+            covered *= fanIn;
+        }
+        if (covered >= numRuns || fanIn >= maxFanIn) {
+            break;
         }
+        fanIn++;
+    }
+    return static_cast<int>(fanIn);
+}
 
-        // Update lexicon with term, offset, length, docFrequency
-        int64_t newOffset = outFile.tellp();
-        int32_t length = static_cast<int32_t>(newOffset - termStartOffset);
-        int docFrequency = docIDs.size();
+bool mergeInvertedIndexesMultiPass(const std::vector<std::string>& indexFiles, const std::string& outputIndexFile,
+                                   const std::string& outputLexiconFile, const MergeOptions& options) {
+    int numPasses;
+    int fanIn = planMergeFanIn(indexFiles.size(), options, numPasses);
+    std::cout << "[INFO] Merging " << indexFiles.size() << " runs with fan-in " << fanIn << " in " << numPasses
+              << " pass(es)." << std::endl;
+
+    std::vector<std::string> runs = indexFiles;
+    for (int pass = 1; pass < numPasses; ++pass) {
+        // Merge consecutive groups so each intermediate run still covers a contiguous docID range
+        size_t numGroups = (runs.size() + fanIn - 1) / fanIn;
+        std::vector<std::string> nextRuns(numGroups);
+        std::vector<char> succeeded(numGroups, 0);
+        std::atomic<size_t> nextGroup(0);
+        auto worker = [&]() {
+            for (size_t group = nextGroup++; group < numGroups; group = nextGroup++) {
+                size_t begin = group * fanIn;
+                size_t end = std::min(begin + fanIn, runs.size());
+                if (end - begin == 1) {
+                    nextRuns[group] = runs[begin];
+                    succeeded[group] = 1;
+                    continue;
+                }
+                nextRuns[group] = options.intermediatePrefix + std::to_string(pass) + "_" + std::to_string(group) + ".txt";
+                std::vector<std::string> groupRuns(runs.begin() + begin, runs.begin() + end);
+                succeeded[group] = mergeRunsToRun(groupRuns, nextRuns[group], options.readBufferSize);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int i = 1; i < options.numThreads; ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
 
-        lexiconOut << currentTerm << " " << termStartOffset << " " << length << " " << docFrequency << "\n";
+        // Remove the previous pass's intermediate runs; the parser's runs are kept
+        for (const std::string& run : runs) {
+            if (std::find(nextRuns.begin(), nextRuns.end(), run) == nextRuns.end() &&
+                std::find(indexFiles.begin(), indexFiles.end(), run) == indexFiles.end()) {
+                std::remove(run.c_str());
+            }
+        }
+        if (std::find(succeeded.begin(), succeeded.end(), 0) != succeeded.end()) {
+            std::cerr << "Error: Merge pass " << pass << " failed." << std::endl;
+            for (const std::string& run : nextRuns) {
+                if (std::find(indexFiles.begin(), indexFiles.end(), run) == indexFiles.end()) {
+                    std::remove(run.c_str());
+                }
+            }
+            return false;
+        }
+        std::cout << "[INFO] Merge pass " << pass << " produced " << nextRuns.size() << " runs." << std::endl;
+        runs.swap(nextRuns);
     }
 
-    // Close all files
-    for (int i = 0; i < numFiles; ++i) {
-        inputFiles[i].close();
+    bool merged = mergeInvertedIndexesParallel(runs, outputIndexFile, outputLexiconFile, options.numThreads,
+                                               options.readBufferSize);
+
+    if (numPasses > 1) {
+        for (const std::string& run : runs) {
+            if (std::find(indexFiles.begin(), indexFiles.end(), run) == indexFiles.end()) {
+                std::remove(run.c_str());
+            }
+        }
     }
-    outFile.close();
-    lexiconOut.close();
-    std::cout << "[INFO] Merged inverted index and lexicon generated successfully." << std::endl;
+    return merged;
 }
@@ -0,0 +1,37 @@
+#ifndef MERGER_H
+#define MERGER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Options controlling how the merger schedules its passes
+struct MergeOptions {
+    // Term ranges merged in parallel in each pass
+    int numThreads = 1;
+    // Maximum runs merged at once; 0 derives it from the memory budget and fd limit
+    int fanIn = 0;
+    // Read buffer per open run
+    size_t readBufferSize = static_cast<size_t>(1) << 20;
+    // Memory available for run read buffers across all threads
+    size_t memoryBudgetBytes = static_cast<size_t>(1024) * 1024 * 1024;
+    // Prefix for the intermediate runs written by earlier passes
+    std::string intermediatePrefix = "tmp/merge_pass";
+};
+
+// All merges return false on failure and never leave a partially written index in place
+
+// Single-threaded, single-pass merge of all runs into the final index and lexicon
+bool mergeInvertedIndexes(const std::vector<std::string>& indexFiles, const std::string& outputIndexFile,
+                          const std::string& outputLexiconFile);
+
+// Single-pass merge with one term range per thread
+bool mergeInvertedIndexesParallel(const std::vector<std::string>& indexFiles, const std::string& outputIndexFile,
+                                  const std::string& outputLexiconFile, int numThreads, size_t readBufferSize);
+
+// Multi-pass merge: runs are merged in groups of at most the planned fan-in into
+// intermediate runs until one final parallel pass can open them all
+bool mergeInvertedIndexesMultiPass(const std::vector<std::string>& indexFiles, const std::string& outputIndexFile,
+                                   const std::string& outputLexiconFile, const MergeOptions& options);
+
+#endif // MERGER_H
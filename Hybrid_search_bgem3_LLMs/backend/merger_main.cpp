@@ -2,14 +2,15 @@
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <thread>
+#include "merger.h"
+#include "shards.h"
 
-void mergeInvertedIndexes(const std::vector<std::string>& indexFiles, const std::string& outputIndexFile, const std::string& outputLexiconFile);
-
-int main() {
-    std::string tempFilePrefix = "tmp/temp_postings_";
-    std::string outputIndexFile = "tmp/final_inverted_index.bin";
-    std::string outputLexiconFile = "tmp/lexicon.txt";
-
+// Merge the runs named tempFilePrefix1.txt, tempFilePrefix2.txt, ... into one index.
+// Returns false if the merge failed.
+bool mergeRunFiles(const std::string& tempFilePrefix, const std::string& outputIndexFile,
+               const std::string& outputLexiconFile, const MergeOptions& options) {
     // Collect names of temporary files generated by the parser
     std::vector<std::string> tempFileNames;
     int tempFileIndex = 1;
@@ -23,6 +24,56 @@ int main() {
         tempFileIndex++;
     }
 
-    mergeInvertedIndexes(tempFileNames, outputIndexFile, outputLexiconFile);
-    return 0;
+    // The parser's in-memory mode writes the final index itself and leaves no runs
+    if (tempFileNames.empty()) {
+        std::cout << "[INFO] No temporary posting files found in " << tempFilePrefix << "*, nothing to merge." << std::endl;
+        return true;
+    }
+
+    return mergeInvertedIndexesMultiPass(tempFileNames, outputIndexFile, outputLexiconFile, options);
+}
+
+int main(int argc, char* argv[]) {
+    std::string tempFilePrefix = "tmp/temp_postings_";
+    std::string outputIndexFile = "tmp/final_inverted_index.bin";
+    std::string outputLexiconFile = "tmp/lexicon.txt";
+    MergeOptions options;
+    options.numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Optional flags: --threads=N merges N term ranges in parallel, --fan-in=N caps the
+    // runs merged at once, --read-buffer-kb=N sets the buffer per open run and
+    // --memory-budget-mb=N bounds the buffers of all open runs
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 10, "--threads=") == 0) {
+            options.numThreads = std::max(1, std::stoi(arg.substr(10)));
+        } else if (arg.compare(0, 9, "--fan-in=") == 0) {
+            options.fanIn = std::stoi(arg.substr(9));
+        } else if (arg.compare(0, 17, "--read-buffer-kb=") == 0) {
+            options.readBufferSize = std::max(1ull, std::stoull(arg.substr(17))) * 1024;
+        } else if (arg.compare(0, 19, "--memory-budget-mb=") == 0) {
+            options.memoryBudgetBytes = std::stoull(arg.substr(19)) * 1024 * 1024;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--threads=N] [--fan-in=N] [--read-buffer-kb=N] [--memory-budget-mb=N]" << std::endl;
+            return 1;
+        }
+    }
+
+    // A sharded build has runs in each shard's directory and is merged shard by shard
+    std::vector<ShardInfo> shards;
+    if (readShardManifest(SHARD_MANIFEST_FILE, shards)) {
+        for (const ShardInfo& shard : shards) {
+            MergeOptions shardOptions = options;
+            shardOptions.intermediatePrefix = shard.directory + "merge_pass";
+            if (!mergeRunFiles(shard.directory + "temp_postings_", shard.directory + "final_inverted_index.bin",
+                               shard.directory + "lexicon.txt", shardOptions)) {
+                std::cerr << "Error: Merging shard " << shard.directory << " failed." << std::endl;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    return mergeRunFiles(tempFilePrefix, outputIndexFile, outputLexiconFile, options) ? 0 : 1;
 }
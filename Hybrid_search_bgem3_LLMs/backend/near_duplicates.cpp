@@ -0,0 +1,280 @@
+#include "near_duplicates.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include <cmath>
+
+bool parseNearDuplicateMode(const std::string& name, NearDuplicateMode& mode) {
+    if (name == "off") {
+        mode = NearDuplicateMode::OFF;
+    } else if (name == "drop") {
+        mode = NearDuplicateMode::DROP;
+    } else if (name == "collapse") {
+        mode = NearDuplicateMode::COLLAPSE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// 64-bit FNV-1a
+static std::uint64_t hashToken(std::string_view token) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (char c : token) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// SplitMix64 finalizer, so a shingle's hash depends on all of its tokens
+static std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Seeds and odd multipliers of the NUM_HASHES hash functions, fixed so signatures are
+// the same in every build
+struct HashFamily {
+    std::uint64_t seeds[NearDuplicateDetector::NUM_HASHES];
+    std::uint64_t multipliers[NearDuplicateDetector::NUM_HASHES];
+
+    HashFamily() {
+        std::uint64_t state = 0;
+        for (int i = 0; i < NearDuplicateDetector::NUM_HASHES; ++i) {
+            seeds[i] = mix(state += 0x9e3779b97f4a7c15ULL);
+            multipliers[i] = mix(state += 0x9e3779b97f4a7c15ULL) | 1;
+        }
+    }
+};
+
+static const HashFamily hashFamily;
+
+// NearDuplicateDetector implementation
+NearDuplicateDetector::NearDuplicateDetector(double threshold)
+    : threshold(threshold),
+      bucketHeads(NUM_BANDS, std::vector<std::uint32_t>(static_cast<size_t>(1) << BUCKET_BITS, 0)) {
+    // Low bytes of unrelated hashes are equal one time in 256
+    double expectedMatches = NUM_HASHES * (threshold + (1.0 - threshold) / 256.0);
+    minMatches = std::max(1, static_cast<int>(std::ceil(expectedMatches - 1e-9)));
+}
+
+void NearDuplicateDetector::signature(const std::vector<std::string_view>& tokens, Signature& signature) {
+    thread_local std::vector<std::uint64_t> tokenHashes;
+    tokenHashes.clear();
+    for (std::string_view token : tokens) {
+        tokenHashes.push_back(hashToken(token));
+    }
+
+    std::fill(signature.hashes, signature.hashes + NUM_HASHES, UINT32_MAX);
+    // A document shorter than a shingle is a single shingle
+    size_t shingleSize = std::min<size_t>(SHINGLE_SIZE, tokens.size());
+    for (size_t start = 0; start + shingleSize <= tokens.size(); ++start) {
+        std::uint64_t hash = 0;
+        for (size_t i = start; i < start + shingleSize; ++i) {
+            hash = mix(hash + tokenHashes[i]);
+        }
+        for (int h = 0; h < NUM_HASHES; ++h) {
+            std::uint32_t value = static_cast<std::uint32_t>(((hash ^ hashFamily.seeds[h]) * hashFamily.multipliers[h]) >> 32);
+            signature.hashes[h] = std::min(signature.hashes[h], value);
+        }
+    }
+}
+
+std::uint32_t NearDuplicateDetector::bandKey(const Signature& signature, int band) {
+    std::uint64_t key = band;
+    for (int row = 0; row < ROWS_PER_BAND; ++row) {
+        key = mix(key + signature.hashes[band * ROWS_PER_BAND + row]);
+    }
+    return static_cast<std::uint32_t>(key);
+}
+
+std::uint32_t NearDuplicateDetector::find(const Signature& signature, size_t firstRepresentative) const {
+    std::uint8_t bytes[NUM_HASHES];
+    for (int h = 0; h < NUM_HASHES; ++h) {
+        bytes[h] = static_cast<std::uint8_t>(signature.hashes[h]);
+    }
+
+    size_t best = SIZE_MAX;
+    for (int band = 0; band < NUM_BANDS; ++band) {
+        // Buckets list the newest representative first
+        std::uint32_t link = bucketHeads[band][bandKey(signature, band) >> (32 - BUCKET_BITS)];
+        while (link != 0 && link - 1 >= firstRepresentative) {
+            size_t representative = link - 1;
+            if (representative < best) {
+                const std::uint8_t* candidate = &lowBytes[representative * NUM_HASHES];
+                int matches = 0;
+                for (int h = 0; h < NUM_HASHES; ++h) {
+                    matches += candidate[h] == bytes[h];
+                }
+                if (matches >= minMatches) {
+                    best = representative;
+                }
+            }
+            link = bucketLinks[representative * NUM_BANDS + band];
+        }
+    }
+    return best == SIZE_MAX ? NO_CLUSTER_ID : clusterIDs[best];
+}
+
+void NearDuplicateDetector::add(const Signature& signature, std::uint32_t clusterID) {
+    std::uint8_t bytes[NUM_HASHES];
+    for (int h = 0; h < NUM_HASHES; ++h) {
+        bytes[h] = static_cast<std::uint8_t>(signature.hashes[h]);
+    }
+    std::uint32_t keys[NUM_BANDS];
+    for (int band = 0; band < NUM_BANDS; ++band) {
+        keys[band] = bandKey(signature, band);
+    }
+    addKeys(bytes, keys, clusterID);
+}
+
+void NearDuplicateDetector::addKeys(const std::uint8_t* bytes, const std::uint32_t* keys, std::uint32_t clusterID) {
+    std::uint32_t link = static_cast<std::uint32_t>(clusterIDs.size()) + 1;
+    lowBytes.insert(lowBytes.end(), bytes, bytes + NUM_HASHES);
+    bandKeys.insert(bandKeys.end(), keys, keys + NUM_BANDS);
+    clusterIDs.push_back(clusterID);
+    for (int band = 0; band < NUM_BANDS; ++band) {
+        std::uint32_t& head = bucketHeads[band][keys[band] >> (32 - BUCKET_BITS)];
+        bucketLinks.push_back(head);
+        head = link;
+    }
+}
+
+// Each representative is saved as its cluster ID, band keys and low bytes
+bool NearDuplicateDetector::save(const std::string& filePath) const {
+    std::string tempFile = filePath + ".tmp";
+    std::ofstream outFile(tempFile, std::ios::binary);
+    if (!outFile.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << filePath << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < clusterIDs.size(); ++i) {
+        outFile.write(reinterpret_cast<const char*>(&clusterIDs[i]), sizeof(std::uint32_t));
+        outFile.write(reinterpret_cast<const char*>(&bandKeys[i * NUM_BANDS]), NUM_BANDS * sizeof(std::uint32_t));
+        outFile.write(reinterpret_cast<const char*>(&lowBytes[i * NUM_HASHES]), NUM_HASHES);
+    }
+    outFile.close();
+
+    if (!outFile.good() || std::rename(tempFile.c_str(), filePath.c_str()) != 0) {
+        std::cerr << "Error: Failed writing to " << filePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool NearDuplicateDetector::load(const std::string& filePath, size_t numClusters) {
+    std::ifstream inFile(filePath, std::ios::binary);
+    if (!inFile.is_open()) {
+        std::cerr << "Error opening near-duplicate clusters: " << filePath << std::endl;
+        return false;
+    }
+    *this = NearDuplicateDetector(threshold);
+    std::uint32_t clusterID;
+    std::uint32_t keys[NUM_BANDS];
+    std::uint8_t bytes[NUM_HASHES];
+    for (size_t i = 0; i < numClusters; ++i) {
+        inFile.read(reinterpret_cast<char*>(&clusterID), sizeof(clusterID));
+        inFile.read(reinterpret_cast<char*>(keys), sizeof(keys));
+        inFile.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+        if (!inFile) {
+            std::cerr << "Error: Near-duplicate clusters are truncated: " << filePath << std::endl;
+            return false;
+        }
+        addKeys(bytes, keys, clusterID);
+    }
+    return true;
+}
+
+// DeduplicatingReader implementation
+DeduplicatingReader::DeduplicatingReader(DocumentReader& reader, NearDuplicateDetector& detector,
+                                         const TextAnalysis& analysis, int numThreads, std::uint32_t firstDocument,
+                                         std::uint64_t numDuplicates)
+    : reader(reader), detector(detector), analysis(analysis), numThreads(std::max(1, numThreads)), batch(BATCH_SIZE),
+      batchSize(0), batchPosition(0), batchFirstRepresentative(0), nextDocument(firstDocument),
+      numDuplicates(numDuplicates), lastOffset(reader.offset()) {
+}
+
+// Tokenize and hash documents [begin, end) of the batch and look them up among the
+// clusters of earlier batches
+void DeduplicatingReader::analyze(size_t begin, size_t end) {
+    Tokenizer tokenizer(analysis);
+    for (size_t i = begin; i < end; ++i) {
+        BatchDocument& document = batch[i];
+        document.tokenText = document.text;
+        const std::vector<std::string_view>& tokens = tokenizer.tokenizeInPlace(&document.tokenText[0], document.tokenText.size());
+        document.tokens.assign(tokens.begin(), tokens.end());
+        document.earlierCluster = NO_CLUSTER_ID;
+        if (!document.tokens.empty()) {
+            NearDuplicateDetector::signature(document.tokens, document.signature);
+            document.earlierCluster = detector.find(document.signature);
+        }
+    }
+}
+
+bool DeduplicatingReader::readBatch() {
+    batchSize = 0;
+    batchPosition = 0;
+    SourceDocument source;
+    while (batchSize < BATCH_SIZE && reader.next(source)) {
+        BatchDocument& document = batch[batchSize++];
+        document.passageID.assign(source.passageID.data(), source.passageID.size());
+        document.text.assign(source.text.data(), source.text.size());
+        document.offset = source.offset;
+        document.endOffset = reader.offset();
+    }
+    if (batchSize == 0) {
+        return false;
+    }
+
+    batchFirstRepresentative = detector.numClusters();
+    size_t sliceSize = (batchSize + numThreads - 1) / numThreads;
+    std::vector<std::thread> workers;
+    for (size_t begin = sliceSize; begin < batchSize; begin += sliceSize) {
+        workers.emplace_back(&DeduplicatingReader::analyze, this, begin, std::min(begin + sliceSize, batchSize));
+    }
+    analyze(0, std::min(sliceSize, batchSize));
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    return true;
+}
+
+bool DeduplicatingReader::next(SourceDocument& document, const std::vector<std::string_view>*& tokens,
+                               std::uint32_t& clusterID, bool& duplicate) {
+    if (batchPosition == batchSize && !readBatch()) {
+        return false;
+    }
+    const BatchDocument& batchDocument = batch[batchPosition++];
+    document.passageID = batchDocument.passageID;
+    document.text = batchDocument.text;
+    document.offset = batchDocument.offset;
+    tokens = &batchDocument.tokens;
+    lastOffset = batchDocument.endOffset;
+    std::uint32_t number = nextDocument++;
+
+    // A document without tokens has no meaningful signature and stays on its own
+    clusterID = number;
+    duplicate = false;
+    if (batchDocument.tokens.empty()) {
+        return true;
+    }
+    std::uint32_t earlierCluster = batchDocument.earlierCluster;
+    if (earlierCluster == NO_CLUSTER_ID) {
+        earlierCluster = detector.find(batchDocument.signature, batchFirstRepresentative);
+    }
+    if (earlierCluster == NO_CLUSTER_ID) {
+        detector.add(batchDocument.signature, number);
+    } else {
+        clusterID = earlierCluster;
+        duplicate = true;
+        numDuplicates++;
+    }
+    return true;
+}
@@ -0,0 +1,142 @@
+#ifndef NEAR_DUPLICATES_H
+#define NEAR_DUPLICATES_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "document_reader.h"
+#include "doc_metadata.h"
+#include "tokenizer.h"
+
+// Near-duplicate detection at index time. A document's features are its shingles of
+// SHINGLE_SIZE consecutive tokens, and its signature holds the minimum of NUM_HASHES hash
+// functions over them (MinHash), so the fraction of equal positions in two signatures
+// estimates the Jaccard similarity of the shingle sets. Two documents are near-duplicates
+// when that estimate reaches the threshold.
+//
+// Candidates are found by LSH banding: the signature is split into NUM_BANDS bands of
+// ROWS_PER_BAND hashes, and only documents agreeing on a whole band are compared. Pairs
+// with a similarity of 0.8 share a band with probability 0.98, pairs at 0.5 with 0.4.
+//
+// Documents are clustered in collection order: a document joins the earliest cluster
+// whose first document (its representative) is similar enough, or else starts a new
+// cluster. A cluster's ID is the docID its representative had when the parser numbered
+// it, so IDs stay unique when documents are later reordered, merged or deleted.
+//
+// For verification the detector keeps the low byte of each of a representative's hashes
+// (b-bit MinHash); with its cluster ID and bucket links that is about 68 bytes per cluster.
+enum class NearDuplicateMode { OFF, DROP, COLLAPSE };
+
+// Parse a --dedup name (off, drop or collapse); returns false if it is unknown
+bool parseNearDuplicateMode(const std::string& name, NearDuplicateMode& mode);
+
+class NearDuplicateDetector {
+public:
+    static const int NUM_BANDS = 8;
+    static const int ROWS_PER_BAND = 4;
+    static const int NUM_HASHES = NUM_BANDS * ROWS_PER_BAND;
+    // Consecutive tokens hashed together as one feature
+    static const int SHINGLE_SIZE = 2;
+
+    struct Signature {
+        std::uint32_t hashes[NUM_HASHES];
+    };
+
+    // threshold is the estimated Jaccard similarity at which documents are near-duplicates
+    explicit NearDuplicateDetector(double threshold);
+
+    double similarityThreshold() const { return threshold; }
+    // MinHash signature of a document with at least one token
+    static void signature(const std::vector<std::string_view>& tokens, Signature& signature);
+
+    // Cluster of the earliest representative similar to signature, only looking at
+    // representatives numbered firstRepresentative or later; NO_CLUSTER_ID if there is
+    // none. Safe to call from several threads while no cluster is being added.
+    std::uint32_t find(const Signature& signature, size_t firstRepresentative = 0) const;
+    // Start a cluster with this signature as its representative
+    void add(const Signature& signature, std::uint32_t clusterID);
+    size_t numClusters() const { return clusterIDs.size(); }
+
+    // The representatives are appended to the file in order, so a file written later than a
+    // checkpoint still holds that checkpoint's clusters as its first numClusters records
+    bool save(const std::string& filePath) const;
+    bool load(const std::string& filePath, size_t numClusters);
+
+private:
+    static const int BUCKET_BITS = 20;
+
+    double threshold;
+    // Fewest equal low bytes that make a representative similar enough
+    int minMatches;
+    std::vector<std::uint8_t> lowBytes;      // NUM_HASHES per representative
+    std::vector<std::uint32_t> bandKeys;     // NUM_BANDS per representative, kept for save()
+    std::vector<std::uint32_t> clusterIDs;
+    // Per band, the newest representative in each bucket plus one (0 for an empty bucket),
+    // and per representative and band the previous one in the same bucket plus one
+    std::vector<std::vector<std::uint32_t>> bucketHeads;
+    std::vector<std::uint32_t> bucketLinks;
+
+    static std::uint32_t bandKey(const Signature& signature, int band);
+    void addKeys(const std::uint8_t* bytes, const std::uint32_t* keys, std::uint32_t clusterID);
+};
+
+// Reads documents ahead in batches and assigns each to a near-duplicate cluster. The
+// documents of a batch are tokenized, hashed and looked up among the clusters of earlier
+// batches on numThreads threads; each is then checked against the clusters started
+// earlier in its own batch as it is returned. The clusters are therefore the same as a
+// sequential pass would find, whatever the thread count.
+class DeduplicatingReader {
+public:
+    static const size_t BATCH_SIZE = 4096;
+
+    // Documents are numbered from firstDocument in the order they are read, which is their
+    // docID when every document is indexed; a new cluster takes its document's number as ID
+    // numDuplicates carries the count over from an earlier reader, e.g. when resuming.
+    // Documents are tokenized with analysis, so the tokens can be indexed as they are.
+    DeduplicatingReader(DocumentReader& reader, NearDuplicateDetector& detector, const TextAnalysis& analysis,
+                        int numThreads, std::uint32_t firstDocument, std::uint64_t numDuplicates = 0);
+
+    // Read the next document and its tokens, which stay valid until the next call. duplicate
+    // is set when the document is a near-duplicate of an earlier one; clusterID is its
+    // cluster either way. Returns false at the end of the input or on an error.
+    bool next(SourceDocument& document, const std::vector<std::string_view>*& tokens,
+              std::uint32_t& clusterID, bool& duplicate);
+    // Input offset just past the last document returned
+    std::uint64_t offset() const { return lastOffset; }
+    // Number of the next document returned
+    std::uint32_t nextNumber() const { return nextDocument; }
+    // Documents returned as duplicates so far
+    std::uint64_t duplicates() const { return numDuplicates; }
+
+private:
+    struct BatchDocument {
+        std::string passageID;
+        std::string text;
+        std::string tokenText;     // Lower-cased, analyzed copy of text that the tokens point into
+        std::vector<std::string_view> tokens;
+        std::uint64_t offset = 0;
+        std::uint64_t endOffset = 0;
+        NearDuplicateDetector::Signature signature;
+        std::uint32_t earlierCluster = NO_CLUSTER_ID;
+    };
+
+    DocumentReader& reader;
+    NearDuplicateDetector& detector;
+    TextAnalysis analysis;
+    int numThreads;
+    std::vector<BatchDocument> batch;
+    size_t batchSize;
+    size_t batchPosition;
+    // Representatives added before the current batch
+    size_t batchFirstRepresentative;
+    std::uint32_t nextDocument;
+    std::uint64_t numDuplicates;
+    std::uint64_t lastOffset;
+
+    bool readBatch();
+    void analyze(size_t begin, size_t end);
+};
+
+#endif // NEAR_DUPLICATES_H
@@ -0,0 +1,135 @@
+#include "net.h"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+// Milliseconds left until the deadline, or -1 if it has passed
+static int remainingMs(Deadline deadline) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    return left > 0 ? static_cast<int>(left) : -1;
+}
+
+static bool waitFor(int fd, short events, Deadline deadline) {
+    while (true) {
+        int timeout = remainingMs(deadline);
+        if (timeout < 0) {
+            return false;
+        }
+        struct pollfd pollFd = {fd, events, 0};
+        int result = poll(&pollFd, 1, timeout);
+        if (result > 0) {
+            return true;
+        }
+        if (result == 0 || errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+int listenOn(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 64) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connectTo(const std::string& host, int port, Deadline deadline) {
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0 || addresses == nullptr) {
+        return -1;
+    }
+
+    int fd = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(addresses);
+        return -1;
+    }
+    // Non-blocking so connect, send and receive can all respect the deadline
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    int result = connect(fd, addresses->ai_addr, addresses->ai_addrlen);
+    freeaddrinfo(addresses);
+    if (result != 0 && errno != EINPROGRESS) {
+        ::close(fd);
+        return -1;
+    }
+    if (result != 0) {
+        int error = 0;
+        socklen_t errorSize = sizeof(error);
+        if (!waitFor(fd, POLLOUT, deadline) || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorSize) != 0 || error != 0) {
+            ::close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+bool sendAll(int fd, const std::string& data, Deadline deadline) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t result = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result > 0) {
+            sent += static_cast<size_t>(result);
+        } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            if (!waitFor(fd, POLLOUT, deadline)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool readLine(int fd, std::string& buffer, std::string& line, Deadline deadline) {
+    char chunk[4096];
+    while (true) {
+        size_t newline = buffer.find('\n');
+        if (newline != std::string::npos) {
+            line.assign(buffer, 0, newline);
+            buffer.erase(0, newline + 1);
+            return true;
+        }
+        ssize_t result = recv(fd, chunk, sizeof(chunk), 0);
+        if (result > 0) {
+            buffer.append(chunk, static_cast<size_t>(result));
+        } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            if (!waitFor(fd, POLLIN, deadline)) {
+                return false;
+            }
+        } else {
+            return false; // Closed or failed
+        }
+    }
+}
+
+void closeSocket(int fd) {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef NET_H
+#define NET_H
+
+#include <string>
+#include <chrono>
+
+// Minimal blocking-with-deadline TCP helpers for the broker and the query server.
+// Messages are newline-terminated text lines.
+typedef std::chrono::steady_clock::time_point Deadline;
+
+// Listen on all interfaces; returns the socket or -1
+int listenOn(int port);
+// Connect to host:port, giving up at the deadline; returns the socket or -1
+int connectTo(const std::string& host, int port, Deadline deadline);
+// Send all bytes before the deadline
+bool sendAll(int fd, const std::string& data, Deadline deadline);
+// Read one line (without the newline) before the deadline; buffer keeps bytes read past it
+bool readLine(int fd, std::string& buffer, std::string& line, Deadline deadline);
+void closeSocket(int fd);
+
+#endif // NET_H
@@ -6,6 +6,24 @@
 #include <vector>
 #include <algorithm>
 #include <cctype>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <functional>
+#include <sys/stat.h>
+#include "parser.h"
+#include "index_writer.h"
+#include "tokenizer.h"
+#include "document_reader.h"
+#include "arena.h"
+#include "doc_metadata.h"
+#include "doc_store.h"
+#include "shards.h"
+#include "deleted_docs.h"
+#include "near_duplicates.h"
 
 // Define the Posting struct
 struct Posting {
@@ -19,56 +37,56 @@ std::vector<Posting> postingsBuffer;
 // const size_t maxBufferSize = 1000000;
 const size_t maxBufferSize = 20 * 1024 * 1024; // ~20 MB memory usage
 
+// Growable compressed posting list for one term, used by the in-memory indexing mode.
+// Postings are appended as variable-byte (docID gap, freq) pairs.
+struct InMemoryPostingList {
+    std::vector<std::uint8_t> bytes;
+    int lastDocID = 0;
+};
+
+// In-memory index built while parsing, and the bytes it currently accounts for
+std::unordered_map<std::string, InMemoryPostingList> inMemoryIndex;
+size_t inMemoryBytes = 0;
+// Rough per-term cost of a hash map node, its key and an empty vector
+const size_t inMemoryTermOverhead = 96;
+
 // Global variables
 std::vector<std::string> tempFileNames;
-std::unordered_map<int, std::string> pageTable;
-std::unordered_map<int, int> documentLengths;
 std::unordered_map<std::string, int> docFrequencyMap;
-std::unordered_map<int, int64_t> passageOffsets; // New map to store passage offsets
-int totalDocumentLength = 0;
-int totalDocuments = 0;
-
-// Function to check if a string contains only ASCII characters
-bool isAscii(const std::string& str) {
-    return std::all_of(str.begin(), str.end(), [](unsigned char c) {
-        return c >= 0 && c <= 127;
-    });
-}
-
-// Tokenization function
-std::vector<std::string> tokenize(const std::string& text) {
-    std::vector<std::string> tokens;
-    std::string processedText = text;
-
-    // Remove punctuation and convert to lowercase
-    std::transform(processedText.begin(), processedText.end(), processedText.begin(),
-        [](char c) -> char {
-            if (std::ispunct(static_cast<unsigned char>(c))) {
-                return ' ';
-            } else {
-                return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
-            }
-        });
-
-    std::istringstream tokenStream(processedText);
-    std::string token;
-    while (tokenStream >> token) {
-        if (isAscii(token)) {
-            tokens.push_back(token);
-        }
-    }
-
-    return tokens;
-}
+// Lengths, collection offsets and passage IDs, indexed by docID
+DocMetadataBuilder docMetadata;
+
+// Tokenizer shared with the query processor, set up with the build's text analysis
+Tokenizer tokenizer;
+// Near-duplicate clusters of the whole collection, when detection is on; shared by all shards
+std::unique_ptr<NearDuplicateDetector> nearDuplicateDetector;
+
+// What stemming and stopwords did to the documents indexed in this run, measured against
+// the plain tokens when an analysis is enabled
+struct AnalysisStats {
+    Tokenizer surfaceTokenizer;
+    std::unordered_set<std::uint64_t> surfaceVocabulary;  // Hashes of the distinct plain tokens
+    std::unordered_set<std::uint64_t> vocabulary;         // Hashes of the distinct indexed terms
+    std::vector<std::uint64_t> documentHashes;
+    std::uint64_t surfaceTokens = 0;
+    std::uint64_t tokens = 0;
+    std::uint64_t surfacePostings = 0;
+    std::uint64_t postings = 0;
+};
+std::unique_ptr<AnalysisStats> analysisStats;
 
+// Per-thread arena and term count map, cleared rather than freed between documents
+thread_local Arena termArena;
+thread_local TermCountMap termFreqMap(termArena);
+// Reused key buffer for lookups in the string-keyed maps
+thread_local std::string termKey;
 
 // Function to update the postings buffer with term frequencies
-void updatePostingsBuffer(const std::unordered_map<std::string, int>& termFreqMap, int docID) {
-    for (const auto& termFreq : termFreqMap) {
-        const std::string& term = termFreq.first;
-        int freq = termFreq.second;
-        postingsBuffer.push_back({term, docID, freq});
-        docFrequencyMap[term]++;
+void updatePostingsBuffer(const TermCountMap& termFreqMap, int docID) {
+    for (const TermCountMap::Entry& termFreq : termFreqMap.entries()) {
+        termKey.assign(termFreq.term.data(), termFreq.term.size());
+        postingsBuffer.push_back({termKey, docID, termFreq.count});
+        docFrequencyMap[termKey]++;
     }
 }
 
@@ -100,145 +118,690 @@ void writePostingsBufferToDisk(int tempFileIndex, const std::string& tempFilePre
     std::cout << "[INFO] Wrote postings to " << tempFileName << std::endl;
 }
 
-// Function to save document frequencies
-void saveDocumentFrequencies(const std::string& docFreqFile) {
-    std::ofstream outFile(docFreqFile);
-    if (!outFile.is_open()) {
-        std::cerr << "Error: Unable to open file for writing: " << docFreqFile << std::endl;
-        return;
+// Function to add a document's postings to the in-memory index
+void updateInMemoryIndex(const TermCountMap& termFreqMap, int docID) {
+    for (const TermCountMap::Entry& termFreq : termFreqMap.entries()) {
+        termKey.assign(termFreq.term.data(), termFreq.term.size());
+        auto it = inMemoryIndex.find(termKey);
+        if (it == inMemoryIndex.end()) {
+            it = inMemoryIndex.emplace(termKey, InMemoryPostingList()).first;
+            inMemoryBytes += termKey.size() + inMemoryTermOverhead;
+        }
+        InMemoryPostingList& list = it->second;
+
+        size_t capacityBefore = list.bytes.capacity();
+        varByteEncode(docID - list.lastDocID, list.bytes);
+        varByteEncode(termFreq.count, list.bytes);
+        list.lastDocID = docID;
+        inMemoryBytes += list.bytes.capacity() - capacityBefore;
+
+        docFrequencyMap[termKey]++;
     }
+}
 
-    for (const auto& entry : docFrequencyMap) {
-        outFile << entry.first << " " << entry.second << "\n";
+// Function to decode an in-memory posting list into absolute docIDs and freqs
+void decodeInMemoryPostingList(const InMemoryPostingList& list, std::vector<int>& docIDs, std::vector<int>& freqs) {
+    docIDs.clear();
+    freqs.clear();
+    int docID = 0;
+    size_t pos = 0;
+    while (pos < list.bytes.size()) {
+        int values[2];
+        for (int v = 0; v < 2; ++v) {
+            int number = 0;
+            int shift = 0;
+            while (true) {
+                std::uint8_t byte = list.bytes[pos++];
+                number |= (byte & 0x7F) << shift;
+                if (byte & 0x80) {
+                    break;
+                }
+                shift += 7;
+            }
+            values[v] = number;
+        }
+        docID += values[0];
+        docIDs.push_back(docID);
+        freqs.push_back(values[1]);
     }
+}
 
-    outFile.close();
+// Function to get the in-memory index terms in lexicon (sorted) order
+std::vector<const std::pair<const std::string, InMemoryPostingList>*> sortedInMemoryTerms() {
+    std::vector<const std::pair<const std::string, InMemoryPostingList>*> entries;
+    entries.reserve(inMemoryIndex.size());
+    for (const auto& entry : inMemoryIndex) {
+        entries.push_back(&entry);
+    }
+    std::sort(entries.begin(), entries.end(), [](const std::pair<const std::string, InMemoryPostingList>* a,
+                                                 const std::pair<const std::string, InMemoryPostingList>* b) {
+        return a->first < b->first;
+    });
+    return entries;
 }
 
-// Function to save document lengths
-void saveDocumentLengths(const std::string& docLengthsFile) {
-    std::ofstream outFile(docLengthsFile);
+// Function to spill the in-memory index to a temporary run file, in the same
+// format as writePostingsBufferToDisk, when it outgrows the memory budget
+void spillInMemoryIndexToDisk(int tempFileIndex, const std::string& tempFilePrefix) {
+    std::string tempFileName = tempFilePrefix + std::to_string(tempFileIndex) + ".txt";
+    std::ofstream outFile(tempFileName);
     if (!outFile.is_open()) {
-        std::cerr << "Error: Unable to open file for writing: " << docLengthsFile << std::endl;
+        std::cerr << "Error: Unable to open file for writing: " << tempFileName << std::endl;
         return;
     }
 
-    for (const auto& entry : documentLengths) {
-        outFile << entry.first << " " << entry.second << "\n";
+    std::vector<int> docIDs;
+    std::vector<int> freqs;
+    for (const auto* entry : sortedInMemoryTerms()) {
+        decodeInMemoryPostingList(entry->second, docIDs, freqs);
+        for (size_t i = 0; i < docIDs.size(); ++i) {
+            outFile << entry->first << " " << docIDs[i] << " " << freqs[i] << "\n";
+        }
     }
-
     outFile.close();
+
+    tempFileNames.push_back(tempFileName);
+    inMemoryIndex.clear();
+    inMemoryBytes = 0;
+    std::cout << "[INFO] Wrote postings to " << tempFileName << std::endl;
 }
 
-// Function to save collection statistics
-void saveCollectionStats(const std::string& statsFile) {
-    std::ofstream outFile(statsFile);
-    if (!outFile.is_open()) {
-        std::cerr << "Error: Unable to open file for writing: " << statsFile << std::endl;
-        return;
+// Function to write the in-memory index directly as the final index and lexicon.
+// Returns false if either file could not be written.
+bool writeInMemoryIndex(const ParserOptions& options, const std::string& tempFilePrefix) {
+    AsyncFileWriter outFile;
+    if (!outFile.open(options.outputIndexFile)) {
+        std::cerr << "Error: Unable to open output file for writing: " << options.outputIndexFile << std::endl;
+        return false;
+    }
+    AsyncFileWriter lexiconOut;
+    if (!lexiconOut.open(options.outputLexiconFile)) {
+        std::cerr << "Error: Unable to open lexicon file for writing: " << options.outputLexiconFile << std::endl;
+        return false;
     }
 
-    double avgDocumentLength = static_cast<double>(totalDocumentLength) / totalDocuments;
-    outFile << totalDocuments << " " << avgDocumentLength << "\n";
-    outFile.close();
+    PostingListWriter writer(outFile, lexiconOut);
+    std::vector<int> docIDs;
+    std::vector<int> freqs;
+    for (const auto* entry : sortedInMemoryTerms()) {
+        decodeInMemoryPostingList(entry->second, docIDs, freqs);
+        writer.beginTerm(entry->first);
+        for (size_t i = 0; i < docIDs.size(); ++i) {
+            writer.addPosting(docIDs[i], freqs[i]);
+        }
+        writer.endTerm();
+    }
+    bool indexWritten = outFile.close();
+    bool lexiconWritten = lexiconOut.close();
+    if (!indexWritten || !lexiconWritten) {
+        return false;
+    }
+    inMemoryIndex.clear();
+    inMemoryBytes = 0;
+
+    // Remove runs left over from an earlier run/merge build so the merger does not
+    // overwrite this index with stale postings
+    for (int tempFileIndex = 1; ; ++tempFileIndex) {
+        std::string tempFileName = tempFilePrefix + std::to_string(tempFileIndex) + ".txt";
+        if (std::remove(tempFileName.c_str()) != 0) {
+            break;
+        }
+    }
+    std::cout << "[INFO] Wrote in-memory index to " << options.outputIndexFile << std::endl;
+    return true;
 }
 
-// Function to save the page table
-void savePageTable(const std::string& pageTableFile) {
-    std::ofstream outFile(pageTableFile);
+// Function to save document frequencies, in term order so the file does not depend on
+// the hash map's history. Returns false if the file could not be written.
+bool saveDocumentFrequencies(const std::string& docFreqFile) {
+    std::ofstream outFile(docFreqFile);
     if (!outFile.is_open()) {
-        std::cerr << "Error: Unable to open file for writing: " << pageTableFile << std::endl;
-        return;
+        std::cerr << "Error: Unable to open file for writing: " << docFreqFile << std::endl;
+        return false;
     }
 
-    for (const auto& entry : pageTable) {
-        int docID = entry.first;
-        const std::string& docName = entry.second;
-        outFile << docID << " " << docName << "\n";
+    std::vector<const std::pair<const std::string, int>*> entries;
+    entries.reserve(docFrequencyMap.size());
+    for (const auto& entry : docFrequencyMap) {
+        entries.push_back(&entry);
+    }
+    std::sort(entries.begin(), entries.end(), [](const std::pair<const std::string, int>* a,
+                                                 const std::pair<const std::string, int>* b) {
+        return a->first < b->first;
+    });
+    for (const auto* entry : entries) {
+        outFile << entry->first << " " << entry->second << "\n";
     }
 
     outFile.close();
+    if (!outFile.good()) {
+        std::cerr << "Error: Failed writing to " << docFreqFile << std::endl;
+        return false;
+    }
+    return true;
 }
 
-// Function to save passage offsets
-void savePassageOffsets(const std::string& passageOffsetsFile) {
-    std::ofstream outFile(passageOffsetsFile);
-    if (!outFile.is_open()) {
-        std::cerr << "Error: Unable to open file for writing: " << passageOffsetsFile << std::endl;
-        return;
+const char PARSER_CHECKPOINT_MAGIC[8] = {'P', 'A', 'R', 'S', 'E', 'C', 'K', '1'};
+
+// Progress of a parse, saved whenever a run has been written to disk. Everything the
+// parser has produced at that point (the runs, the metadata and passages of the parsed
+// documents, the document frequencies) depends only on how far it has read, so a build
+// continued from a checkpoint writes exactly the files an uninterrupted one would.
+struct ParserCheckpoint {
+    std::uint64_t inputSize = 0;    // Size of the collection, to refuse a changed input
+    int numShards = 1;
+    int shard = 0;                  // Shard being parsed
+    std::uint64_t inputOffset = 0;  // Byte offset of the shard's next document
+    int nextDocID = 0;              // Shard-local docID of that document; 0 at a shard's start
+    int tempFileIndex = 0;          // The shard's runs 1..tempFileIndex are complete
+    std::vector<ShardInfo> completedShards;
+    // Near-duplicate detection settings, the number of the next document, the duplicates
+    // found so far and how many clusters the detector holds; the clusters themselves are in
+    // a file beside the checkpoint
+    int nearDuplicateMode = 0;
+    double nearDuplicateThreshold = 0.0;
+    std::uint32_t nextDocumentNumber = 0;
+    std::uint64_t numDuplicates = 0;
+    std::uint64_t numClusters = 0;
+    std::string analysis;           // TextAnalysis::describe() of the build
+};
+
+template <typename T>
+void writeValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void readValue(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+void writeString(std::ostream& out, const std::string& text) {
+    writeValue(out, static_cast<std::uint64_t>(text.size()));
+    out.write(text.data(), text.size());
+}
+
+void readString(std::istream& in, std::string& text) {
+    std::uint64_t size = 0;
+    readValue(in, size);
+    text.resize(in ? size : 0);
+    in.read(&text[0], text.size());
+}
+
+// Save a checkpoint. In the middle of a shard it also holds the document store writer's
+// state and the document frequencies, and the partial metadata goes to a file beside it,
+// as do the near-duplicate clusters; the checkpoint's rename commits them together.
+bool writeCheckpoint(const ParserOptions& options, const ParserCheckpoint& checkpoint, DocStoreWriter* docStore) {
+    std::string metadataFile = options.checkpointFile + ".metadata";
+    if (checkpoint.nextDocID > 0 && !docMetadata.write(metadataFile)) {
+        return false;
+    }
+    if (nearDuplicateDetector != nullptr && !nearDuplicateDetector->save(options.checkpointFile + ".clusters")) {
+        return false;
     }
 
-    for (const auto& entry : passageOffsets) {
-        int docID = entry.first;
-        int64_t offset = entry.second;
-        outFile << docID << " " << offset << "\n";
+    std::string tempFile = options.checkpointFile + ".tmp";
+    std::ofstream out(tempFile, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << tempFile << std::endl;
+        return false;
+    }
+    out.write(PARSER_CHECKPOINT_MAGIC, sizeof(PARSER_CHECKPOINT_MAGIC));
+    writeValue(out, checkpoint.inputSize);
+    writeValue(out, checkpoint.numShards);
+    writeValue(out, checkpoint.shard);
+    writeValue(out, checkpoint.inputOffset);
+    writeValue(out, checkpoint.nextDocID);
+    writeValue(out, checkpoint.tempFileIndex);
+    writeValue(out, static_cast<std::uint64_t>(checkpoint.completedShards.size()));
+    for (const ShardInfo& shard : checkpoint.completedShards) {
+        writeString(out, shard.directory);
+        writeValue(out, shard.docIDBase);
+        writeValue(out, shard.numDocs);
     }
+    writeValue(out, checkpoint.nearDuplicateMode);
+    writeValue(out, checkpoint.nearDuplicateThreshold);
+    writeValue(out, checkpoint.nextDocumentNumber);
+    writeValue(out, checkpoint.numDuplicates);
+    writeValue(out, checkpoint.numClusters);
+    writeString(out, checkpoint.analysis);
+    if (checkpoint.nextDocID > 0) {
+        if (!docStore->saveState(out)) {
+            std::cerr << "Error: Unable to save the document store state in " << tempFile << std::endl;
+            return false;
+        }
+        writeValue(out, static_cast<std::uint64_t>(docFrequencyMap.size()));
+        for (const auto& entry : docFrequencyMap) {
+            writeString(out, entry.first);
+            writeValue(out, entry.second);
+        }
+    }
+    out.close();
 
-    outFile.close();
+    if (!out.good() || std::rename(tempFile.c_str(), options.checkpointFile.c_str()) != 0) {
+        std::cerr << "Error: Failed writing to " << options.checkpointFile << std::endl;
+        return false;
+    }
+    return true;
 }
 
-// Main parsing function
-void parseDocuments(const std::string& filePath, const std::string& tempFilePrefix) {
-    std::ifstream file(filePath);
-    std::string line;
-    int docID = 0;
-    int tempFileIndex = 0;
+// Read a checkpoint. With docStore set and a shard in progress, also restore the shard's
+// document store writer, document frequencies and metadata.
+bool readCheckpoint(const ParserOptions& options, ParserCheckpoint& checkpoint, DocStoreWriter* docStore) {
+    std::ifstream in(options.checkpointFile, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error opening checkpoint: " << options.checkpointFile << std::endl;
+        return false;
+    }
+    char magic[sizeof(PARSER_CHECKPOINT_MAGIC)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, PARSER_CHECKPOINT_MAGIC, sizeof(magic)) != 0) {
+        std::cerr << "Error: Unrecognized checkpoint: " << options.checkpointFile << std::endl;
+        return false;
+    }
+    std::uint64_t numCompleted = 0;
+    readValue(in, checkpoint.inputSize);
+    readValue(in, checkpoint.numShards);
+    readValue(in, checkpoint.shard);
+    readValue(in, checkpoint.inputOffset);
+    readValue(in, checkpoint.nextDocID);
+    readValue(in, checkpoint.tempFileIndex);
+    readValue(in, numCompleted);
+    checkpoint.completedShards.clear();
+    for (std::uint64_t s = 0; in && s < numCompleted; ++s) {
+        ShardInfo shard;
+        readString(in, shard.directory);
+        readValue(in, shard.docIDBase);
+        readValue(in, shard.numDocs);
+        checkpoint.completedShards.push_back(shard);
+    }
+    readValue(in, checkpoint.nearDuplicateMode);
+    readValue(in, checkpoint.nearDuplicateThreshold);
+    readValue(in, checkpoint.nextDocumentNumber);
+    readValue(in, checkpoint.numDuplicates);
+    readValue(in, checkpoint.numClusters);
+    readString(in, checkpoint.analysis);
+    if (!in) {
+        std::cerr << "Error: Checkpoint is truncated: " << options.checkpointFile << std::endl;
+        return false;
+    }
+    if (docStore == nullptr || checkpoint.nextDocID == 0) {
+        return true;
+    }
 
-    if (!file.is_open()) {
-        std::cerr << "Error opening file: " << filePath << std::endl;
-        return;
+    if (!docStore->resume(options.outputDocStoreFile, in)) {
+        return false;
+    }
+    std::uint64_t numTerms = 0;
+    readValue(in, numTerms);
+    docFrequencyMap.clear();
+    docFrequencyMap.reserve(in ? numTerms : 0);
+    std::string term;
+    int docFrequency = 0;
+    for (std::uint64_t t = 0; in && t < numTerms; ++t) {
+        readString(in, term);
+        readValue(in, docFrequency);
+        docFrequencyMap[term] = docFrequency;
+    }
+    if (!in) {
+        std::cerr << "Error: Checkpoint is truncated: " << options.checkpointFile << std::endl;
+        return false;
     }
 
-    while (true) {
-        int64_t offset = file.tellg(); // Record the offset before reading the line
-        if (!std::getline(file, line)) {
-            break;
-        }
-        passageOffsets[docID] = offset; // Store the offset for this docID
-        totalDocuments++;
+    // The metadata file may be newer than the checkpoint; only its first nextDocID
+    // documents belong to it
+    DocMetadata metadata;
+    if (!metadata.open(options.checkpointFile + ".metadata") ||
+        metadata.numDocs() < static_cast<std::uint64_t>(checkpoint.nextDocID)) {
+        std::cerr << "Error: Checkpoint metadata does not match " << options.checkpointFile << std::endl;
+        return false;
+    }
+    docMetadata = DocMetadataBuilder();
+    for (int docID = 0; docID < checkpoint.nextDocID; ++docID) {
+        docMetadata.addDocument(metadata.passageID(docID), metadata.length(docID), metadata.offset(docID),
+                                metadata.clusterID(docID));
+    }
+    return true;
+}
+
+void removeCheckpoint(const ParserOptions& options) {
+    std::remove(options.checkpointFile.c_str());
+    std::remove((options.checkpointFile + ".metadata").c_str());
+    std::remove((options.checkpointFile + ".clusters").c_str());
+}
+
+// Record how far parsing has got in the checkpoint
+void advanceCheckpoint(ParserCheckpoint& checkpoint, const DocumentReader& reader, const DeduplicatingReader* dedupReader) {
+    checkpoint.inputOffset = dedupReader != nullptr ? dedupReader->offset() : reader.offset();
+    if (dedupReader != nullptr) {
+        checkpoint.nextDocumentNumber = dedupReader->nextNumber();
+        checkpoint.numDuplicates = dedupReader->duplicates();
+        checkpoint.numClusters = nearDuplicateDetector->numClusters();
+    }
+}
 
-        std::istringstream ss(line);
-        std::string passageID, passageText;
-        std::getline(ss, passageID, '\t');
-        std::getline(ss, passageText, '\t'); 
+// Hash a token for the vocabulary counts of AnalysisStats
+std::uint64_t tokenHash(std::string_view token) {
+    return std::hash<std::string_view>()(token);
+}
 
-        pageTable[docID] = passageID;
+void countAnalysis(AnalysisStats& stats, std::string_view text, const std::vector<std::string_view>& tokens,
+                   const TermCountMap& termCounts) {
+    stats.documentHashes.clear();
+    for (std::string_view token : stats.surfaceTokenizer.tokenize(text)) {
+        stats.documentHashes.push_back(tokenHash(token));
+    }
+    stats.surfaceTokens += stats.documentHashes.size();
+    std::sort(stats.documentHashes.begin(), stats.documentHashes.end());
+    stats.documentHashes.erase(std::unique(stats.documentHashes.begin(), stats.documentHashes.end()), stats.documentHashes.end());
+    stats.surfacePostings += stats.documentHashes.size();
+    stats.surfaceVocabulary.insert(stats.documentHashes.begin(), stats.documentHashes.end());
+
+    stats.tokens += tokens.size();
+    stats.postings += termCounts.entries().size();
+    for (const TermCountMap::Entry& termCount : termCounts.entries()) {
+        stats.vocabulary.insert(tokenHash(termCount.term));
+    }
+}
 
-        // Tokenize and calculate term frequencies
-        std::vector<std::string> tokens = tokenize(passageText);
-        int docLength = tokens.size();
-        documentLengths[docID] = docLength;
-        totalDocumentLength += docLength;
+// Parse the reader's next documents into one index, stopping after maxDocs documents or
+// at the end of the input. Returns the number of documents parsed, or -1 on error;
+// docIDs start at 0. If the checkpoint is in the middle of this shard, parsing continues
+// from it. With near-duplicate detection the documents come through dedupReader, which
+// reads ahead of reader.
+int parseShard(DocumentReader& reader, DeduplicatingReader* dedupReader, size_t maxDocs, const std::string& tempFilePrefix,
+               const ParserOptions& options, ParserCheckpoint& checkpoint) {
+    int docID = checkpoint.nextDocID;
+    int tempFileIndex = checkpoint.tempFileIndex;
+    // An in-memory index is never checkpointed, so a resumed shard is already on runs
+    bool inMemory = options.inMemory && docID == 0;
+
+    DocStoreWriter docStore;
+    if (docID > 0) {
+        if (!readCheckpoint(options, checkpoint, &docStore)) {
+            return -1;
+        }
+        for (int runIndex = 1; runIndex <= tempFileIndex; ++runIndex) {
+            tempFileNames.push_back(tempFilePrefix + std::to_string(runIndex) + ".txt");
+        }
+    } else if (!docStore.open(options.outputDocStoreFile)) {
+        return -1;
+    }
 
-        std::unordered_map<std::string, int> termFreqMap;
-        for (const std::string& token : tokens) {
-            termFreqMap[token]++;
+    docMetadata.setAnalysis(options.analysis.describe());
+
+    // A TSV file is read straight from its mapping; other formats and compressed input
+    // are decoded by the reader as the documents are consumed
+    SourceDocument document;
+    const std::vector<std::string_view>* tokens = nullptr;
+    std::uint32_t clusterID = NO_CLUSTER_ID;
+    bool duplicate = false;
+    bool collapse = options.nearDuplicateMode == NearDuplicateMode::COLLAPSE;
+    while (static_cast<size_t>(docID) < maxDocs &&
+           (dedupReader != nullptr ? dedupReader->next(document, tokens, clusterID, duplicate) : reader.next(document))) {
+        if (dedupReader == nullptr) {
+            // Tokenize and calculate term frequencies
+            tokens = &tokenizer.tokenize(document.text);
+        } else if (duplicate && !collapse) {
+            continue;
         }
+        int docLength = tokens->size();
+        docMetadata.addDocument(document.passageID, docLength, document.offset, collapse ? clusterID : NO_CLUSTER_ID);
+        docStore.addPassage(document.text);
 
-        // Update postings buffer
-        updatePostingsBuffer(termFreqMap, docID);
+        termFreqMap.clear();
+        for (std::string_view token : *tokens) {
+            termFreqMap.add(token);
+        }
+        if (analysisStats != nullptr) {
+            countAnalysis(*analysisStats, document.text, *tokens, termFreqMap);
+        }
 
-        // Write to disk if buffer is full
-        if (postingsBuffer.size() >= maxBufferSize) {
-            tempFileIndex++;
-            writePostingsBufferToDisk(tempFileIndex, tempFilePrefix);
+        bool wroteRun = false;
+        if (inMemory) {
+            // Append to the in-memory index, falling back to runs once over budget
+            updateInMemoryIndex(termFreqMap, docID);
+            if (inMemoryBytes > options.memoryBudgetBytes) {
+                std::cout << "[INFO] In-memory index exceeded memory budget, falling back to temporary runs." << std::endl;
+                tempFileIndex++;
+                spillInMemoryIndexToDisk(tempFileIndex, tempFilePrefix);
+                inMemory = false;
+                wroteRun = true;
+            }
+        } else {
+            // Update postings buffer
+            updatePostingsBuffer(termFreqMap, docID);
+
+            // Write to disk if buffer is full
+            if (postingsBuffer.size() >= maxBufferSize) {
+                tempFileIndex++;
+                writePostingsBufferToDisk(tempFileIndex, tempFilePrefix);
+                wroteRun = true;
+            }
         }
         docID++;
+
+        // Every posting parsed so far is in a run: a consistent point to resume from
+        if (wroteRun) {
+            advanceCheckpoint(checkpoint, reader, dedupReader);
+            checkpoint.nextDocID = docID;
+            checkpoint.tempFileIndex = tempFileIndex;
+            if (!writeCheckpoint(options, checkpoint, &docStore)) {
+                return -1;
+            }
+        }
     }
 
-    // Write any remaining postings to disk
-    if (!postingsBuffer.empty()) {
+    // Input cut off in the middle of a record is an error, not a smaller collection: drop
+    // what this shard wrote so the partial output does not look like a finished build. The
+    // checkpoint goes too, since the input has to change before the build can complete.
+    if (reader.failed()) {
+        for (int runIndex = 1; runIndex <= tempFileIndex; ++runIndex) {
+            std::remove((tempFilePrefix + std::to_string(runIndex) + ".txt").c_str());
+        }
+        docStore.discard();
+        removeCheckpoint(options);
+        std::cerr << "Error: The input could not be read to the end; no index was written." << std::endl;
+        return -1;
+    }
+
+    if (inMemory) {
+        // Everything fit in memory: write the final index and lexicon directly
+        if (!writeInMemoryIndex(options, tempFilePrefix)) {
+            return -1;
+        }
+    } else if (!postingsBuffer.empty()) {
+        // Write any remaining postings to disk
         tempFileIndex++;
         writePostingsBufferToDisk(tempFileIndex, tempFilePrefix);
     }
 
-    file.close();
+    // Save the document frequencies, per-document metadata and passages, then start afresh.
+    // If any of them fails the checkpoint is kept, so the build can still be resumed; the
+    // store goes last because a resume continues its temporary file.
+    if (!saveDocumentFrequencies(options.outputDocFrequencyFile) || !docMetadata.write(options.outputMetadataFile) ||
+        !docStore.close()) {
+        return -1;
+    }
+    docMetadata = DocMetadataBuilder();
+    docFrequencyMap.clear();
+    return docID;
+}
+
+// Summarize what near-duplicate detection found
+void reportNearDuplicates(const DeduplicatingReader* dedupReader) {
+    if (dedupReader == nullptr) {
+        return;
+    }
+    std::cout << "[INFO] " << dedupReader->duplicates() << " of " << dedupReader->nextNumber()
+              << " documents are near-duplicates of earlier ones." << std::endl;
+}
 
-    // Save document frequencies, document lengths, collection stats, page table, and passage offsets
-    saveDocumentFrequencies("tmp/doc_frequencies.txt");
-    saveDocumentLengths("tmp/document_lengths.txt");
-    saveCollectionStats("tmp/collection_stats.txt");
-    savePageTable("tmp/page_table.txt");
-    savePassageOffsets("tmp/passage_offsets.txt"); // Save passage offsets
+// Summarize how much smaller stemming and stopwords made the vocabulary and the postings
+void reportAnalysis(const ParserOptions& options, bool resumed) {
+    if (analysisStats == nullptr) {
+        return;
+    }
+    const AnalysisStats& stats = *analysisStats;
+    auto reduction = [](std::uint64_t before, std::uint64_t after) {
+        double percent = before == 0 ? 0.0 : 100.0 * (static_cast<double>(before) - after) / before;
+        return " (-" + std::to_string(static_cast<int>(percent + 0.5)) + "%)";
+    };
+    std::cout << "[INFO] Text analysis (" << options.analysis.summary() << ")"
+              << (resumed ? ", over the documents parsed since resuming:" : ":") << std::endl;
+    std::cout << "[INFO]   vocabulary " << stats.surfaceVocabulary.size() << " -> " << stats.vocabulary.size() << " terms"
+              << reduction(stats.surfaceVocabulary.size(), stats.vocabulary.size()) << std::endl;
+    std::cout << "[INFO]   postings " << stats.surfacePostings << " -> " << stats.postings
+              << reduction(stats.surfacePostings, stats.postings) << std::endl;
+    std::cout << "[INFO]   tokens " << stats.surfaceTokens << " -> " << stats.tokens
+              << reduction(stats.surfaceTokens, stats.tokens) << std::endl;
+}
+
+// Main parsing function; returns false if the build failed
+bool parseDocuments(const std::string& filePath, const std::string& tempFilePrefix, const ParserOptions& options) {
+    CollectionFormat format = formatFromFileName(filePath);
+    if (!options.inputFormat.empty() && !parseCollectionFormat(options.inputFormat, format)) {
+        std::cerr << "Error: Unknown collection format: " << options.inputFormat << std::endl;
+        return false;
+    }
+    int numReaderThreads = options.numReaderThreads > 0 ? options.numReaderThreads
+                                                        : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::unique_ptr<DocumentReader> reader = openDocumentReader(filePath, format, numReaderThreads);
+    struct stat fileStat;
+    if (reader == nullptr || stat(filePath.c_str(), &fileStat) != 0) {
+        return false;
+    }
+
+    ParserCheckpoint checkpoint;
+    checkpoint.inputSize = static_cast<std::uint64_t>(fileStat.st_size);
+    checkpoint.numShards = options.numShards;
+    checkpoint.nearDuplicateMode = static_cast<int>(options.nearDuplicateMode);
+    checkpoint.nearDuplicateThreshold = options.nearDuplicateMode != NearDuplicateMode::OFF ? options.nearDuplicateThreshold : 0.0;
+    checkpoint.analysis = options.analysis.describe();
+    tokenizer = Tokenizer(options.analysis);
+    analysisStats.reset();
+    if (options.analysis.enabled()) {
+        analysisStats = std::make_unique<AnalysisStats>();
+    }
+    nearDuplicateDetector.reset();
+    if (options.nearDuplicateMode != NearDuplicateMode::OFF) {
+        nearDuplicateDetector = std::make_unique<NearDuplicateDetector>(options.nearDuplicateThreshold);
+    }
+    std::ifstream existingCheckpoint(options.checkpointFile);
+    bool resumed = false;
+    if (options.resume && existingCheckpoint.is_open()) {
+        ParserCheckpoint saved;
+        if (!readCheckpoint(options, saved, nullptr)) {
+            return false;
+        }
+        if (saved.inputSize != checkpoint.inputSize || saved.numShards != checkpoint.numShards) {
+            std::cerr << "Error: " << options.checkpointFile << " is for a different collection or shard count" << std::endl;
+            return false;
+        }
+        if (saved.nearDuplicateMode != checkpoint.nearDuplicateMode || saved.nearDuplicateThreshold != checkpoint.nearDuplicateThreshold) {
+            std::cerr << "Error: " << options.checkpointFile << " was written with different near-duplicate settings" << std::endl;
+            return false;
+        }
+        if (saved.analysis != checkpoint.analysis) {
+            std::cerr << "Error: " << options.checkpointFile << " was written with different stemming or stopwords" << std::endl;
+            return false;
+        }
+        if (nearDuplicateDetector != nullptr &&
+            !nearDuplicateDetector->load(options.checkpointFile + ".clusters", saved.numClusters)) {
+            return false;
+        }
+        checkpoint = saved;
+        resumed = true;
+        std::cout << "[INFO] Resuming at document " << checkpoint.nextDocID << " of shard " << checkpoint.shard
+                  << " (byte offset " << checkpoint.inputOffset << ")." << std::endl;
+    } else if (options.resume) {
+        std::cout << "[INFO] No checkpoint found, parsing from the start." << std::endl;
+    } else if (existingCheckpoint.is_open()) {
+        std::cout << "[INFO] Replacing the checkpoint of an earlier run; use --resume to continue it instead." << std::endl;
+    }
+    existingCheckpoint.close();
+
+    if (!reader->seek(checkpoint.inputOffset)) {
+        return false;
+    }
+    std::unique_ptr<DeduplicatingReader> dedupReader;
+    if (nearDuplicateDetector != nullptr) {
+        int numDedupThreads = options.numDedupThreads > 0 ? options.numDedupThreads
+                                                          : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        dedupReader = std::make_unique<DeduplicatingReader>(*reader, *nearDuplicateDetector, options.analysis, numDedupThreads,
+                                                            checkpoint.nextDocumentNumber, checkpoint.numDuplicates);
+    }
+
+    if (options.numShards <= 1) {
+        if (parseShard(*reader, dedupReader.get(), SIZE_MAX, tempFilePrefix, options, checkpoint) < 0 || reader->failed()) {
+            return false;
+        }
+        // A single index replaces any earlier sharded build, and its docIDs any old deletions
+        std::remove(SHARD_MANIFEST_FILE.c_str());
+        std::remove(("tmp/" + DELETED_DOCS_FILE_NAME).c_str());
+        removeCheckpoint(options);
+        reportNearDuplicates(dedupReader.get());
+        reportAnalysis(options, resumed);
+        std::cout << "[INFO] Parsing completed." << std::endl;
+        return true;
+    }
+
+    // Split the collection into equal contiguous docID ranges, one index per shard
+    // Counting the documents takes an extra pass over the input; for compressed or
+    // non-TSV input that means decoding it twice. Dropped near-duplicates are counted, so
+    // shards come out smaller than planned.
+    size_t numDocuments = 0;
+    {
+        std::unique_ptr<DocumentReader> counter = openDocumentReader(filePath, format, numReaderThreads);
+        SourceDocument document;
+        while (counter != nullptr && counter->next(document)) {
+            numDocuments++;
+        }
+        if (counter == nullptr || counter->failed()) {
+            return false;
+        }
+    }
+    size_t docsPerShard = std::max<size_t>(1, (numDocuments + options.numShards - 1) / options.numShards);
+
+    std::vector<ShardInfo> shards = checkpoint.completedShards;
+    int docIDBase = 0;
+    for (const ShardInfo& completed : shards) {
+        docIDBase += completed.numDocs;
+    }
+    for (int shard = checkpoint.shard; shard < options.numShards; ++shard) {
+        std::string directory = shardDirectory(shard);
+        ParserOptions shardOptions = options;
+        shardOptions.outputIndexFile = directory + "final_inverted_index.bin";
+        shardOptions.outputLexiconFile = directory + "lexicon.txt";
+        shardOptions.outputMetadataFile = directory + "doc_metadata.bin";
+        shardOptions.outputDocStoreFile = directory + "doc_store.bin";
+        shardOptions.outputDocFrequencyFile = directory + "doc_frequencies.txt";
+
+        int numDocs = parseShard(*reader, dedupReader.get(), docsPerShard, directory + "temp_postings_", shardOptions, checkpoint);
+        if (numDocs < 0 || reader->failed()) {
+            return false;
+        }
+        std::remove((directory + DELETED_DOCS_FILE_NAME).c_str());
+        shards.push_back({directory, docIDBase, numDocs});
+        docIDBase += numDocs;
+        std::cout << "[INFO] Parsed shard " << shard << " (" << numDocs << " documents)." << std::endl;
+
+        // The next shard starts from scratch at the current line
+        checkpoint.completedShards = shards;
+        checkpoint.shard = shard + 1;
+        advanceCheckpoint(checkpoint, *reader, dedupReader.get());
+        checkpoint.nextDocID = 0;
+        checkpoint.tempFileIndex = 0;
+        if (!writeCheckpoint(options, checkpoint, nullptr)) {
+            return false;
+        }
+    }
+    if (!writeShardManifest(SHARD_MANIFEST_FILE, shards)) {
+        return false;
+    }
+    removeCheckpoint(options);
+    reportNearDuplicates(dedupReader.get());
+    reportAnalysis(options, resumed);
     std::cout << "[INFO] Parsing completed." << std::endl;
-}
\ No newline at end of file
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <string>
+#include <cstddef>
+#include "near_duplicates.h"
+#include "text_analysis.h"
+
+// Options controlling how parseDocuments builds the index
+struct ParserOptions {
+    // Build compressed posting lists in memory and write the final index directly,
+    // skipping the temporary runs and the merger
+    bool inMemory = false;
+    // Memory budget for the in-memory posting buffers; when exceeded the parser
+    // spills what it has as a run and continues with the run/merge path
+    size_t memoryBudgetBytes = static_cast<size_t>(2048) * 1024 * 1024;
+    std::string outputIndexFile = "tmp/final_inverted_index.bin";
+    std::string outputLexiconFile = "tmp/lexicon.txt";
+    // Binary document lengths, collection offsets and passage IDs (see doc_metadata.h)
+    std::string outputMetadataFile = "tmp/doc_metadata.bin";
+    // Compressed passage texts for snippet retrieval (see doc_store.h)
+    std::string outputDocStoreFile = "tmp/doc_store.bin";
+    std::string outputDocFrequencyFile = "tmp/doc_frequencies.txt";
+    // Collection format (see document_reader.h); empty picks it from the file name
+    std::string inputFormat;
+    // Threads decompressing gzip input; 0 uses one per core
+    int numReaderThreads = 0;
+    // Near-duplicate detection (see near_duplicates.h): DROP leaves near-duplicates of
+    // earlier documents out of the index; COLLAPSE indexes them and records their cluster
+    // in the document metadata, so the query processor returns one result per cluster
+    NearDuplicateMode nearDuplicateMode = NearDuplicateMode::OFF;
+    // Estimated Jaccard similarity of token shingles at which documents are near-duplicates
+    double nearDuplicateThreshold = 0.8;
+    // Threads tokenizing and hashing documents for detection; 0 uses one per core
+    int numDedupThreads = 0;
+    // Stemming and stopword removal applied to every token; recorded in the document
+    // metadata, and queries must be analyzed the same way
+    TextAnalysis analysis;
+    // Split the collection into this many document-partitioned shards under tmp/shard_N/
+    // (see shards.h); 1 builds a single index in tmp/
+    int numShards = 1;
+    // Progress is saved here after every run written to disk and removed once parsing
+    // completes; with resume a build continues from it instead of starting over.
+    // Compressed input is decompressed again up to the saved offset.
+    std::string checkpointFile = "tmp/parser_checkpoint.bin";
+    bool resume = false;
+};
+
+// Parse a collection into runs or an index; returns false if the build failed
+bool parseDocuments(const std::string& filePath, const std::string& tempFilePrefix, const ParserOptions& options);
+
+#endif // PARSER_H
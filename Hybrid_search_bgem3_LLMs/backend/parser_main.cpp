@@ -1,10 +1,61 @@
 #include <string>
+#include <iostream>
+#include <algorithm>
+#include "parser.h"
 
-void parseDocuments(const std::string& inputFilePath, const std::string& tempFilePrefix);
-
-int main() {
+int main(int argc, char* argv[]) {
     std::string inputFilePath = "collection.tsv";
     std::string tempFilePrefix = "tmp/temp_postings_";
-    parseDocuments(inputFilePath, tempFilePrefix);
-    return 0;
+    ParserOptions options;
+
+    // Optional flags: --in-memory, --memory-budget-mb=N, --shards=N, --resume, and
+    // --input=FILE, --format=tsv|jsonl|trec|warc and --reader-threads=N for other collections,
+    // --dedup=off|drop|collapse, --dedup-threshold=X and --dedup-threads=N for near-duplicates,
+    // and --stem and --stopwords=none|english|FILE for the text analysis
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 8, "--input=") == 0) {
+            inputFilePath = arg.substr(8);
+        } else if (arg.compare(0, 9, "--format=") == 0) {
+            options.inputFormat = arg.substr(9);
+        } else if (arg.compare(0, 17, "--reader-threads=") == 0) {
+            options.numReaderThreads = std::stoi(arg.substr(17));
+        } else if (arg.compare(0, 8, "--dedup=") == 0) {
+            if (!parseNearDuplicateMode(arg.substr(8), options.nearDuplicateMode)) {
+                std::cerr << "Error: Unknown near-duplicate mode: " << arg.substr(8) << std::endl;
+                return 1;
+            }
+        } else if (arg.compare(0, 18, "--dedup-threshold=") == 0) {
+            options.nearDuplicateThreshold = std::stod(arg.substr(18));
+        } else if (arg.compare(0, 16, "--dedup-threads=") == 0) {
+            options.numDedupThreads = std::stoi(arg.substr(16));
+        } else if (arg == "--stem") {
+            options.analysis.stem = true;
+        } else if (arg.compare(0, 12, "--stopwords=") == 0) {
+            if (!loadStopwords(arg.substr(12), options.analysis)) {
+                return 1;
+            }
+        } else if (arg == "--in-memory") {
+            options.inMemory = true;
+        } else if (arg.compare(0, 19, "--memory-budget-mb=") == 0) {
+            options.memoryBudgetBytes = std::stoull(arg.substr(19)) * 1024 * 1024;
+        } else if (arg.compare(0, 9, "--shards=") == 0) {
+            options.numShards = std::max(1, std::stoi(arg.substr(9)));
+        } else if (arg == "--resume") {
+            options.resume = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--input=FILE] [--format=tsv|jsonl|trec|warc] [--reader-threads=N]"
+                      << " [--in-memory] [--memory-budget-mb=N] [--shards=N] [--resume]"
+                      << " [--dedup=off|drop|collapse] [--dedup-threshold=X] [--dedup-threads=N]"
+                      << " [--stem] [--stopwords=none|english|FILE]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!(options.nearDuplicateThreshold > 0.0 && options.nearDuplicateThreshold <= 1.0)) {
+        std::cerr << "Error: --dedup-threshold must be above 0 and at most 1" << std::endl;
+        return 1;
+    }
+
+    return parseDocuments(inputFilePath, tempFilePrefix, options) ? 0 : 1;
 }
@@ -1,8 +1,17 @@
 #include "index_api.h"
+#include "tokenizer.h"
+#include "doc_metadata.h"
+#include "doc_store.h"
+#include "snippet.h"
+#include "collection_reader.h"
+#include "shards.h"
+#include "deleted_docs.h"
+#include "net.h"
 #include <iostream>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <sstream>
 #include <algorithm>
 #include <cmath>
@@ -11,133 +20,196 @@
 #include <cstdint>
 #include <climits>
 #include <fstream>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <chrono>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+// Index and lexicon written by an unsharded build
+const std::string DEFAULT_INDEX_FILE = "tmp/final_inverted_index.bin";
+const std::string DEFAULT_LEXICON_FILE = "tmp/lexicon.txt";
+
+// One document-partitioned index with its own metadata and passages. An unsharded
+// build is a single shard whose docIDs start at 0.
+struct Shard {
+    std::unique_ptr<IndexAPI> indexAPI;
+    // Per-document metadata, mapped from the parser's output
+    DocMetadata docMetadata;
+    // Compressed passage store; the raw collection is only read when it is missing
+    DocStore docStore;
+    CollectionReader collectionReader;
+    // Tombstones; deleted documents are skipped when collecting results
+    DeletedDocs deletedDocs;
+    // Stemming and stopwords the parser applied, from the metadata
+    TextAnalysis analysis;
+    int docIDBase = 0;
+};
+
+// One generation of the index: the shards listed in the manifest when it was loaded.
+// A snapshot is never modified once published. Each query holds a reference to the
+// snapshot it started on, so a reload never changes the index under a running query and
+// the old generation is freed when its last query finishes.
+struct IndexSnapshot {
+    std::vector<std::unique_ptr<Shard>> shards;
+    // The analysis every shard was built with; queries are analyzed the same way
+    TextAnalysis analysis;
+    int generation = 0;
+};
+
+// The published snapshot; read and replaced only with std::atomic_load and std::atomic_store
+std::shared_ptr<const IndexSnapshot> currentSnapshot;
 
-// Data structures to hold loaded data
-std::unordered_map<int, int> documentLengths;
-int totalDocuments = 0;
-double avgDocumentLength = 0.0;
-std::unordered_map<int, int64_t> passageOffsets; // Map to store passage offsets
-std::ifstream collectionFile; // Collection file stream
+// Stemming and stopwords given on the command line, set before any index is loaded.
+// Without them queries follow the analysis recorded in the index; with them an index
+// analyzed differently is refused.
+TextAnalysis queryAnalysis;
+bool queryAnalysisGiven = false;
+
+// Collection statistics used by BM25. They cover the whole collection, not just the shards
+// loaded here, so scores from different shards and servers are comparable.
+struct CollectionStats {
+    int totalDocuments = 0;
+    double avgDocumentLength = 0.0;
+};
 
 // Define a struct to store document and score for top-k results
 struct DocScore {
     int docID;
     double score;
-    bool operator<(const DocScore& other) const {
-        return score < other.score;  // Min-heap for lowest scores
-    }
 };
 
-// Function to load document lengths
-void loadDocumentLengths(const std::string& docLengthsFile) {
-    std::ifstream inFile(docLengthsFile);
-    if (!inFile.is_open()) {
-        std::cerr << "Error opening document lengths file!" << std::endl;
-        return;
-    }
-
-    int docID, length;
-    while (inFile >> docID >> length) {
-        documentLengths[docID] = length;
-    }
-
-    inFile.close();
-}
-
-// Function to load collection statistics
-void loadCollectionStats(const std::string& statsFile) {
-    std::ifstream inFile(statsFile);
-    if (!inFile.is_open()) {
-        std::cerr << "Error opening collection stats file!" << std::endl;
-        return;
-    }
-
-    inFile >> totalDocuments >> avgDocumentLength;
-
-    inFile.close();
-}
-
-// Function to load passage offsets
-void loadPassageOffsets(const std::string& passageOffsetsFile) {
-    std::ifstream inFile(passageOffsetsFile);
-    if (!inFile.is_open()) {
-        std::cerr << "Error opening passage offsets file!" << std::endl;
-        return;
-    }
-
-    int docID;
-    int64_t offset;
-    while (inFile >> docID >> offset) {
-        passageOffsets[docID] = offset;
+// Rank order: higher scores first, lower docIDs first among equal scores. Ties are broken
+// by docID so a sharded index returns the same documents as a single one.
+bool rankBefore(const DocScore& a, const DocScore& b) {
+    if (a.score != b.score) {
+        return a.score > b.score;
     }
-
-    inFile.close();
+    return a.docID < b.docID;
 }
 
-// Tokenization function
-std::vector<std::string> tokenizeQuery(const std::string& text) {
-    std::vector<std::string> tokens;
-    std::string processedText = text;
-
-    // Remove punctuation and convert to lowercase
-    std::transform(processedText.begin(), processedText.end(), processedText.begin(),
-        [](char c) -> char {
-            if (std::ispunct(static_cast<unsigned char>(c))) {
-                return ' ';
-            } else {
-                return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
-            }
-        });
-
-    std::istringstream tokenStream(processedText);
-    std::string token;
-    while (tokenStream >> token) {
-        tokens.push_back(token);
+// Heap ordering that keeps the lowest-ranked result on top
+struct RankAfter {
+    bool operator()(const DocScore& a, const DocScore& b) const {
+        return rankBefore(a, b);
     }
+};
+typedef std::priority_queue<DocScore, std::vector<DocScore>, RankAfter> TopKHeap;
 
-    return tokens;
+// Tokenization function, shared with the parser so query terms match indexed terms
+std::vector<std::string> tokenizeQuery(const IndexSnapshot& snapshot, const std::string& text) {
+    Tokenizer tokenizer(snapshot.analysis);
+    const std::vector<std::string_view>& views = tokenizer.tokenize(text);
+    return std::vector<std::string>(views.begin(), views.end());
 }
 
 // BM25 computation
-double computeBM25(int termFrequency, int docFrequency, int documentLength) {
+double computeBM25(int termFrequency, int docFrequency, int documentLength, const CollectionStats& stats) {
     double k1 = 1.5;
     double b = 0.75;
-    double idf = std::log((static_cast<double>(totalDocuments) - static_cast<double>(docFrequency) + 0.5) /
+    double idf = std::log((static_cast<double>(stats.totalDocuments) - static_cast<double>(docFrequency) + 0.5) /
                            (static_cast<double>(docFrequency) + 0.5) + 1.0);
 
     double tfComponent = (static_cast<double>(termFrequency) * (k1 + 1.0)) /
-                         (static_cast<double>(termFrequency) + k1 * (1.0 - b + b * (static_cast<double>(documentLength) / avgDocumentLength)));
+                         (static_cast<double>(termFrequency) + k1 * (1.0 - b + b * (static_cast<double>(documentLength) / stats.avgDocumentLength)));
     return idf * tfComponent;
 }
 
-// Function to get passage text given a docID
-std::string getPassageText(int docID) {
-    auto it = passageOffsets.find(docID);
-    if (it == passageOffsets.end()) {
-        return ""; // Passage not found
+// Shard holding a global docID
+Shard& shardOf(const IndexSnapshot& snapshot, int docID) {
+    auto it = std::upper_bound(snapshot.shards.begin(), snapshot.shards.end(), docID,
+        [](int id, const std::unique_ptr<Shard>& shard) { return id < shard->docIDBase; });
+    return **(it - 1);
+}
+
+// Near-duplicate cluster of a global docID; NO_CLUSTER_ID if the index has no clusters
+std::uint32_t clusterOf(const IndexSnapshot& snapshot, int docID) {
+    const Shard& shard = shardOf(snapshot, docID);
+    return shard.docMetadata.clusterID(docID - shard.docIDBase);
+}
+
+// Fetch the passage texts of a page of results in one batch per shard, in rank order
+std::vector<std::string> getPassageTexts(const IndexSnapshot& snapshot, const std::vector<int>& docIDs) {
+    std::vector<std::string> passages(docIDs.size());
+    for (auto& shard : snapshot.shards) {
+        std::vector<size_t> positions;
+        std::vector<int> localDocIDs;
+        for (size_t i = 0; i < docIDs.size(); ++i) {
+            if (&shardOf(snapshot, docIDs[i]) == shard.get()) {
+                positions.push_back(i);
+                localDocIDs.push_back(docIDs[i] - shard->docIDBase);
+            }
+        }
+        if (positions.empty()) {
+            continue;
+        }
+        std::vector<std::string> shardPassages = shard->docStore.is_open()
+            ? shard->docStore.getPassages(localDocIDs)
+            : shard->collectionReader.getPassages(localDocIDs);
+        for (size_t i = 0; i < positions.size(); ++i) {
+            passages[positions[i]] = std::move(shardPassages[i]);
+        }
     }
+    return passages;
+}
 
-    int64_t offset = it->second;
-    collectionFile.clear(); // Clear any EOF flags
-    collectionFile.seekg(offset);
-    if (!collectionFile.good()) {
-        return ""; // Seek failed
+// Snippets of the result passages, in rank order
+std::vector<Snippet> makeSnippets(const IndexSnapshot& snapshot, const std::vector<DocScore>& results,
+                                  const std::vector<std::string>& terms) {
+    std::vector<int> docIDs;
+    for (const auto& result : results) {
+        docIDs.push_back(result.docID);
     }
+    std::vector<std::string> passages = getPassageTexts(snapshot, docIDs);
 
-    std::string line;
-    std::getline(collectionFile, line);
+    SnippetGenerator generator(terms, snapshot.analysis);
+    std::vector<Snippet> snippets;
+    for (const std::string& passage : passages) {
+        snippets.push_back(generator.generate(passage));
+    }
+    return snippets;
+}
 
-    // Split the line by tab to extract passage text
-    std::istringstream ss(line);
-    std::string passageID, passageText;
-    std::getline(ss, passageID, '\t');
-    std::getline(ss, passageText, '\t');
+// Print ranked results with a snippet of each passage and the byte offset:length
+// of every highlighted query term within the snippet
+void printResults(const IndexSnapshot& snapshot, const std::vector<DocScore>& results,
+                  const std::vector<std::string>& terms, int k) {
+    std::vector<Snippet> snippets = makeSnippets(snapshot, results, terms);
+    std::cout << "Top " << k << " documents:" << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const DocScore& result = results[i];
+        const Snippet& snippet = snippets[i];
+        std::cout << "DocID: " << result.docID << ", Score: " << result.score << std::endl;
+        std::cout << "Snippet: " << snippet.text << std::endl;
+        std::cout << "Highlights:";
+        for (const auto& highlight : snippet.highlights) {
+            std::cout << " " << highlight.first << ":" << highlight.second;
+        }
+        std::cout << std::endl;
+    }
+}
 
-    return passageText;
+// Collect a heap's results in rank order, with docIDs made global
+std::vector<DocScore> sortedTopK(TopKHeap& topK, const Shard& shard) {
+    std::vector<DocScore> sortedResults;
+    while (!topK.empty()) {
+        DocScore result = topK.top();
+        result.docID += shard.docIDBase;
+        sortedResults.push_back(result);
+        topK.pop();
+    }
+    std::sort(sortedResults.begin(), sortedResults.end(), rankBefore);
+    return sortedResults;
 }
 
-// Conjunctive Query Processing
-void processConjunctiveQuery(const std::vector<std::string>& terms, IndexAPI& indexAPI, int k) {
+// Conjunctive Query Processing on one shard; docFrequencies are global, aligned with terms
+std::vector<DocScore> processConjunctiveQuery(const std::vector<std::string>& terms, const std::vector<int>& docFrequencies,
+                                              const CollectionStats& stats, Shard& shard, int k) {
+    IndexAPI& indexAPI = *shard.indexAPI;
     // Open all inverted lists
     std::vector<InvertedList*> invLists;
     for (const std::string& term : terms) {
@@ -145,13 +217,11 @@ void processConjunctiveQuery(const std::vector<std::string>& terms, IndexAPI& in
         if (invList != nullptr) {
             invLists.push_back(invList);
         } else {
-            // If any term is not found, no documents can satisfy the conjunctive query
-            std::cout << "No matching documents found." << std::endl;
-            // Close any opened lists
+            // If any term is not found, no documents in this shard can satisfy the query
             for (auto list : invLists) {
                 indexAPI.closeList(list);
             }
-            return;
+            return {};
         }
     }
 
@@ -161,15 +231,14 @@ void processConjunctiveQuery(const std::vector<std::string>& terms, IndexAPI& in
         currentDocIDs[i] = invLists[i]->nextGEQ(0);
         if (currentDocIDs[i] == INT32_MAX) {
             // No documents in one of the lists
-            std::cout << "No matching documents found." << std::endl;
             for (auto list : invLists) {
                 indexAPI.closeList(list);
             }
-            return;
+            return {};
         }
     }
 
-    std::priority_queue<DocScore> topK;
+    TopKHeap topK;
 
     int did = 0;
     while (did <= INT32_MAX) {
@@ -191,21 +260,27 @@ void processConjunctiveQuery(const std::vector<std::string>& terms, IndexAPI& in
             break;
         }
 
-        // Compute BM25 score for the matched document
+        // Compute BM25 score for the matched document, unless it was deleted
+        bool deleted = shard.deletedDocs.isDeleted(did);
         double score = 0.0;
         for (size_t i = 0; i < invLists.size(); ++i) {
-            int termFreq = static_cast<int>(invLists[i]->getScore()); // Assuming getScore returns term frequency
-            int docFrequency = indexAPI.lexicon[terms[i]].docFrequency;
-            int documentLength = documentLengths[did];
-            score += computeBM25(termFreq, docFrequency, documentLength);
+            if (!deleted) {
+                int termFreq = static_cast<int>(invLists[i]->getScore()); // Assuming getScore returns term frequency
+                int docFrequency = docFrequencies[i];
+                int documentLength = shard.docMetadata.length(did);
+                score += computeBM25(termFreq, docFrequency, documentLength, stats);
+            }
             // Advance to next posting
             currentDocIDs[i] = invLists[i]->nextGEQ(did + 1);
         }
+        if (deleted) {
+            continue;
+        }
 
         // Insert into topK heap
         if (topK.size() < static_cast<size_t>(k)) {
             topK.push({ did, score });
-        } else if (score > topK.top().score) {
+        } else if (rankBefore({ did, score }, topK.top())) {
             topK.pop();
             topK.push({ did, score });
         }
@@ -216,84 +291,162 @@ void processConjunctiveQuery(const std::vector<std::string>& terms, IndexAPI& in
         indexAPI.closeList(list);
     }
 
-    // Collect and sort the top-k results
-    std::vector<DocScore> sortedResults;
-    while (!topK.empty()) {
-        sortedResults.push_back(topK.top());
-        topK.pop();
-    }
+    return sortedTopK(topK, shard);
+}
 
-    std::sort(sortedResults.begin(), sortedResults.end(), [](const DocScore& a, const DocScore& b) {
-        return a.score > b.score;
-    });
+// Largest BM25 contribution any document can get from a term: the tf component grows
+// towards k1 + 1 as the term frequency grows, whatever the document length
+double maxBM25(int docFrequency, const CollectionStats& stats) {
+    return computeBM25(INT_MAX, docFrequency, 0, stats);
+}
 
-    // Output top-k results
-    std::cout << "Top " << k << " documents:" << std::endl;
-    for (const auto& result : sortedResults) {
-        std::string passageText = getPassageText(result.docID);
-        std::cout << "DocID: " << result.docID << ", Score: " << result.score << std::endl;
-        std::cout << "Passage: " << passageText << std::endl;
+// Raise a threshold shared by concurrently searched shards to at least value
+void raiseThreshold(std::atomic<double>& threshold, double value) {
+    double current = threshold.load(std::memory_order_relaxed);
+    while (value > current && !threshold.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
     }
 }
 
-// Disjunctive Query Processing
-void processDisjunctiveQuery(const std::vector<std::string>& terms, IndexAPI& indexAPI, int k) {
-    // Open all inverted lists
+// Disjunctive Query Processing on one shard; docFrequencies are global, aligned with terms.
+// Uses MaxScore: lists are ordered by their score upper bound, and the lists whose bounds
+// together cannot lift a document past the current k-th score are never used to find
+// candidates, only probed for documents found through the other lists. The k-th score is
+// shared with the other shards of the query through sharedThreshold (may be null): any
+// shard's k-th score is a lower bound on the global one, so each shard prunes against the
+// best threshold found so far anywhere.
+std::vector<DocScore> processDisjunctiveQuery(const std::vector<std::string>& terms, const std::vector<int>& docFrequencies,
+                                              const CollectionStats& stats, Shard& shard, int k,
+                                              std::atomic<double>* sharedThreshold) {
+    IndexAPI& indexAPI = *shard.indexAPI;
+    // Open all inverted lists, remembering which query term each one belongs to
     std::vector<InvertedList*> invLists;
-    for (const std::string& term : terms) {
-        InvertedList* invList = indexAPI.openList(term);
+    std::vector<int> listDocFrequencies;
+    for (size_t t = 0; t < terms.size(); ++t) {
+        InvertedList* invList = indexAPI.openList(terms[t]);
         if (invList != nullptr) {
             invLists.push_back(invList);
+            listDocFrequencies.push_back(docFrequencies[t]);
         }
     }
 
     if (invLists.empty()) {
-        std::cout << "No matching documents found." << std::endl;
-        return;
+        return {};
+    }
+
+    // Visit lists in increasing order of their upper bound; boundSums[i] bounds the score
+    // a document can collect from lists 0..i
+    size_t numLists = invLists.size();
+    std::vector<size_t> order(numLists);
+    std::vector<double> upperBounds(numLists);
+    for (size_t i = 0; i < numLists; ++i) {
+        order[i] = i;
+        upperBounds[i] = maxBM25(listDocFrequencies[i], stats);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return upperBounds[a] < upperBounds[b]; });
+    std::vector<double> boundSums(numLists);
+    for (size_t i = 0; i < numLists; ++i) {
+        boundSums[i] = upperBounds[order[i]] + (i > 0 ? boundSums[i - 1] : 0.0);
     }
 
     // Initialize pointers for all lists
-    std::vector<int> currentDocIDs(invLists.size(), 0);
-    for (size_t i = 0; i < invLists.size(); ++i) {
+    std::vector<int> currentDocIDs(numLists, 0);
+    for (size_t i = 0; i < numLists; ++i) {
         currentDocIDs[i] = invLists[i]->nextGEQ(0);
     }
 
-    std::priority_queue<DocScore> topK;
-
-    while (true) {
-        // Find the minimum docID among current pointers
+    TopKHeap topK;
+    double threshold = 0.0;
+    // Lists order[0..firstEssential) are non-essential
+    size_t firstEssential = 0;
+    // Per-list contributions, summed in query term order so scores do not depend on pruning
+    std::vector<double> contributions(numLists, 0.0);
+    // Bounds are compared with a little slack so rounding never prunes a document that ties
+    const double slack = 1e-9;
+
+    while (firstEssential < numLists) {
+        // Find the minimum docID among the essential lists
         int minDocID = INT32_MAX;
-        for (size_t i = 0; i < currentDocIDs.size(); ++i) {
-            if (currentDocIDs[i] < minDocID) {
-                minDocID = currentDocIDs[i];
-            }
+        for (size_t e = firstEssential; e < numLists; ++e) {
+            minDocID = std::min(minDocID, currentDocIDs[order[e]]);
         }
 
         if (minDocID == INT32_MAX) {
-            break; // All lists exhausted
+            break; // All essential lists exhausted
+        }
+
+        if (shard.deletedDocs.isDeleted(minDocID)) {
+            for (size_t e = firstEssential; e < numLists; ++e) {
+                if (currentDocIDs[order[e]] == minDocID) {
+                    currentDocIDs[order[e]] = invLists[order[e]]->nextGEQ(minDocID + 1);
+                }
+            }
+            continue;
         }
 
-        // Accumulate scores from all lists that have minDocID
+        std::fill(contributions.begin(), contributions.end(), 0.0);
+        int documentLength = shard.docMetadata.length(minDocID);
         double score = 0.0;
-        for (size_t i = 0; i < invLists.size(); ++i) {
+        // Accumulate scores from the essential lists that have minDocID
+        for (size_t e = firstEssential; e < numLists; ++e) {
+            size_t i = order[e];
             if (currentDocIDs[i] == minDocID) {
                 int termFreq = static_cast<int>(invLists[i]->getScore()); // Assuming getScore returns term frequency
-                int docFrequency = indexAPI.lexicon[terms[i]].docFrequency;
-                int documentLength = documentLengths[minDocID];
-                score += computeBM25(termFreq, docFrequency, documentLength);
+                contributions[i] = computeBM25(termFreq, listDocFrequencies[i], documentLength, stats);
+                score += contributions[i];
 
                 // Advance the list
                 currentDocIDs[i] = invLists[i]->nextGEQ(minDocID + 1);
             }
         }
 
+        // Probe the non-essential lists, strongest first, while the document can still qualify
+        bool pruned = false;
+        for (size_t e = firstEssential; e-- > 0;) {
+            if ((score + boundSums[e]) * (1.0 + slack) < threshold) {
+                pruned = true;
+                break;
+            }
+            size_t i = order[e];
+            if (currentDocIDs[i] < minDocID) {
+                currentDocIDs[i] = invLists[i]->nextGEQ(minDocID);
+            }
+            if (currentDocIDs[i] == minDocID) {
+                int termFreq = static_cast<int>(invLists[i]->getScore());
+                contributions[i] = computeBM25(termFreq, listDocFrequencies[i], documentLength, stats);
+                score += contributions[i];
+            }
+        }
+        if (pruned) {
+            continue;
+        }
+
+        score = 0.0;
+        for (double contribution : contributions) {
+            score += contribution;
+        }
+
         // Insert into topK heap
         if (topK.size() < static_cast<size_t>(k)) {
             topK.push({ minDocID, score });
-        } else if (score > topK.top().score) {
+        } else if (rankBefore({ minDocID, score }, topK.top())) {
             topK.pop();
             topK.push({ minDocID, score });
         }
+
+        // Raise the threshold from the local k-th score and from the other shards. Only
+        // documents scoring strictly below it are skipped: an equal score can still win on docID.
+        if (topK.size() == static_cast<size_t>(k)) {
+            threshold = std::max(threshold, topK.top().score);
+            if (sharedThreshold != nullptr) {
+                raiseThreshold(*sharedThreshold, threshold);
+            }
+        }
+        if (sharedThreshold != nullptr) {
+            threshold = std::max(threshold, sharedThreshold->load(std::memory_order_relaxed));
+        }
+        while (firstEssential < numLists && boundSums[firstEssential] * (1.0 + slack) < threshold) {
+            firstEssential++;
+        }
     }
 
     // Close all inverted lists
@@ -301,61 +454,531 @@ void processDisjunctiveQuery(const std::vector<std::string>& terms, IndexAPI& in
         indexAPI.closeList(list);
     }
 
-    // Collect and sort the top-k results
-    std::vector<DocScore> sortedResults;
-    while (!topK.empty()) {
-        sortedResults.push_back(topK.top());
-        topK.pop();
+    return sortedTopK(topK, shard);
+}
+
+// Open one shard's index, metadata and passage source
+std::unique_ptr<Shard> loadShard(const std::string& indexFilePath, const std::string& lexiconFilePath,
+                                 const std::string& directory, int docIDBase, const std::string& collectionFilePath) {
+    auto shard = std::make_unique<Shard>();
+    shard->docIDBase = docIDBase;
+    if (!shard->docMetadata.open(directory + "doc_metadata.bin")) {
+        return nullptr;
+    }
+    // Query terms would silently miss an index analyzed differently
+    if (!TextAnalysis::fromDescription(shard->docMetadata.analysis(), shard->analysis)) {
+        std::cerr << "Error: Unrecognized text analysis in " << directory << "doc_metadata.bin" << std::endl;
+        return nullptr;
+    }
+    if (queryAnalysisGiven && shard->analysis != queryAnalysis) {
+        std::cerr << "Error: " << directory << " was indexed with " << shard->analysis.summary() << " but queries use "
+                  << queryAnalysis.summary() << "; pass the parser's --stem and --stopwords options or none" << std::endl;
+        return nullptr;
+    }
+    if (!shard->docStore.open(directory + "doc_store.bin")) {
+        if (!shard->collectionReader.open(collectionFilePath, shard->docMetadata)) {
+            std::cerr << "Error opening collection file: " << collectionFilePath << std::endl;
+            return nullptr;
+        }
+    }
+    if (!shard->deletedDocs.load(directory + DELETED_DOCS_FILE_NAME, shard->docMetadata.numDocs())) {
+        return nullptr;
     }
+    shard->indexAPI = std::make_unique<IndexAPI>(indexFilePath, lexiconFilePath);
+    if (!shard->indexAPI->is_open()) {
+        return nullptr;
+    }
+    return shard;
+}
 
-    std::sort(sortedResults.begin(), sortedResults.end(), [](const DocScore& a, const DocScore& b) {
-        return a.score > b.score;
-    });
+// Evaluate a query on every shard in parallel and merge the per-shard top-k lists
+std::vector<DocScore> searchShardsTopK(const IndexSnapshot& snapshot, const std::vector<std::string>& terms,
+                                       const std::vector<int>& docFrequencies, const CollectionStats& stats,
+                                       bool conjunctive, int k) {
+    const auto& shards = snapshot.shards;
+    std::vector<std::vector<DocScore>> shardResults(shards.size());
+    // k-th best score found so far by any shard, for dynamic pruning
+    std::atomic<double> sharedThreshold(0.0);
+    auto search = [&](size_t s) {
+        shardResults[s] = conjunctive ? processConjunctiveQuery(terms, docFrequencies, stats, *shards[s], k)
+                                      : processDisjunctiveQuery(terms, docFrequencies, stats, *shards[s], k, &sharedThreshold);
+    };
+    if (shards.size() == 1) {
+        search(0);
+    } else {
+        std::vector<std::thread> workers;
+        for (size_t s = 0; s < shards.size(); ++s) {
+            workers.emplace_back(search, s);
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
 
-    // Output top-k results
-    std::cout << "Top " << k << " documents:" << std::endl;
-    for (const auto& result : sortedResults) {
-        std::string passageText = getPassageText(result.docID);
-        std::cout << "DocID: " << result.docID << ", Score: " << result.score << std::endl;
-        std::cout << "Passage: " << passageText << std::endl;
+    std::vector<DocScore> results;
+    for (const auto& shardResult : shardResults) {
+        results.insert(results.end(), shardResult.begin(), shardResult.end());
+    }
+    std::sort(results.begin(), results.end(), rankBefore);
+    if (results.size() > static_cast<size_t>(k)) {
+        results.resize(k);
     }
+    return results;
 }
 
-void startQueryProcessor(const std::string& indexFilePath, const std::string& lexiconFilePath, const std::string& collectionFilePath, const std::string& query, const std::string& mode) {
-    loadDocumentLengths("tmp/document_lengths.txt");
-    loadCollectionStats("tmp/collection_stats.txt");
-    loadPassageOffsets("tmp/passage_offsets.txt"); // Load passage offsets
+// Keep only the best-ranked result of each near-duplicate cluster; results are in rank order
+std::vector<DocScore> collapseNearDuplicates(const IndexSnapshot& snapshot, const std::vector<DocScore>& results) {
+    std::unordered_set<std::uint32_t> seenClusters;
+    std::vector<DocScore> collapsed;
+    for (const DocScore& result : results) {
+        std::uint32_t clusterID = clusterOf(snapshot, result.docID);
+        if (clusterID == NO_CLUSTER_ID || seenClusters.insert(clusterID).second) {
+            collapsed.push_back(result);
+        }
+    }
+    return collapsed;
+}
+
+// Top k results of a query over every shard. When the index records near-duplicate
+// clusters only the best result of each cluster is returned, fetching deeper until there
+// are k of them or the matching documents run out.
+std::vector<DocScore> searchShards(const IndexSnapshot& snapshot, const std::vector<std::string>& terms,
+                                   const std::vector<int>& docFrequencies, const CollectionStats& stats,
+                                   bool conjunctive, int k) {
+    bool hasClusters = false;
+    for (const auto& shard : snapshot.shards) {
+        hasClusters = hasClusters || shard->docMetadata.hasClusters();
+    }
+    for (int depth = k; ; depth *= 2) {
+        std::vector<DocScore> results = searchShardsTopK(snapshot, terms, docFrequencies, stats, conjunctive, depth);
+        bool exhausted = results.size() < static_cast<size_t>(depth);
+        if (hasClusters) {
+            results = collapseNearDuplicates(snapshot, results);
+        }
+        if (!hasClusters || exhausted || results.size() >= static_cast<size_t>(k)) {
+            if (results.size() > static_cast<size_t>(k)) {
+                results.resize(k);
+            }
+            return results;
+        }
+    }
+}
+
+// Load the shards listed in the manifest, or the single index when there is none.
+// With onlyShard >= 0 just that shard of the manifest is loaded. Index paths other than
+// the defaults name one index explicitly, which is loaded instead of the manifest with
+// the metadata next to it. Returns nullptr on error.
+std::shared_ptr<IndexSnapshot> loadSnapshot(const std::string& indexFilePath, const std::string& lexiconFilePath,
+                                            const std::string& collectionFilePath, int onlyShard) {
+    auto snapshot = std::make_shared<IndexSnapshot>();
+    bool explicitIndex = indexFilePath != DEFAULT_INDEX_FILE || lexiconFilePath != DEFAULT_LEXICON_FILE;
+    std::vector<ShardInfo> shardInfos;
+    if (!explicitIndex && readShardManifest(SHARD_MANIFEST_FILE, shardInfos)) {
+        if (onlyShard >= static_cast<int>(shardInfos.size())) {
+            std::cerr << "Error: shard " << onlyShard << " not in " << SHARD_MANIFEST_FILE << std::endl;
+            return nullptr;
+        }
+        for (size_t s = 0; s < shardInfos.size(); ++s) {
+            if (onlyShard >= 0 && static_cast<int>(s) != onlyShard) {
+                continue;
+            }
+            const ShardInfo& info = shardInfos[s];
+            auto shard = loadShard(info.directory + "final_inverted_index.bin", info.directory + "lexicon.txt",
+                                   info.directory, info.docIDBase, collectionFilePath);
+            if (shard == nullptr) {
+                return nullptr;
+            }
+            snapshot->shards.push_back(std::move(shard));
+        }
+    } else {
+        if (onlyShard > 0) {
+            std::cerr << "Error: shard " << onlyShard << " requested but the index is not sharded" << std::endl;
+            return nullptr;
+        }
+        size_t slash = indexFilePath.rfind('/');
+        std::string directory = slash == std::string::npos ? "./" : indexFilePath.substr(0, slash + 1);
+        auto shard = loadShard(indexFilePath, lexiconFilePath, directory, 0, collectionFilePath);
+        if (shard == nullptr) {
+            return nullptr;
+        }
+        snapshot->shards.push_back(std::move(shard));
+    }
+
+    // Queries are analyzed once for all shards
+    for (const auto& shard : snapshot->shards) {
+        if (shard->analysis != snapshot->shards[0]->analysis) {
+            std::cerr << "Error: The shards were indexed with different analyses (" << snapshot->shards[0]->analysis.summary()
+                      << " and " << shard->analysis.summary() << ")" << std::endl;
+            return nullptr;
+        }
+    }
+    snapshot->analysis = snapshot->shards.empty() ? queryAnalysis : snapshot->shards[0]->analysis;
+    return snapshot;
+}
+
+// Document count and total length of the loaded shards, not counting deleted documents.
+// Document frequencies still include deleted documents until their segment is merged.
+void localCollectionSize(const IndexSnapshot& snapshot, int& numDocs, std::uint64_t& totalDocumentLength) {
+    numDocs = 0;
+    totalDocumentLength = 0;
+    for (const auto& shard : snapshot.shards) {
+        numDocs += static_cast<int>(shard->docMetadata.numDocs() - shard->deletedDocs.numDeleted());
+        totalDocumentLength += shard->docMetadata.totalDocumentLength() - shard->deletedDocs.deletedLength();
+    }
+}
+
+// Document frequencies of the terms summed over the loaded shards
+std::vector<int> localDocFrequencies(const IndexSnapshot& snapshot, const std::vector<std::string>& terms) {
+    std::vector<int> docFrequencies(terms.size(), 0);
+    for (size_t t = 0; t < terms.size(); ++t) {
+        for (const auto& shard : snapshot.shards) {
+            auto it = shard->indexAPI->lexicon.find(terms[t]);
+            if (it != shard->indexAPI->lexicon.end()) {
+                docFrequencies[t] += it->second.docFrequency;
+            }
+        }
+    }
+    return docFrequencies;
+}
+
+// Answer one broker request. Requests are single tab-separated lines and every response
+// ends with an END line:
+//   STATS<TAB>query
+//     -> STATS numDocs totalDocumentLength df...   (this server's share of the statistics)
+//   SEARCH<TAB>mode<TAB>k<TAB>totalDocuments<TAB>avgDocumentLength<TAB>df df ...<TAB>query
+//     -> RESULT<TAB>docID<TAB>score<TAB>snippet<TAB>highlights<TAB>cluster   (one line per result)
+// cluster is the result's near-duplicate cluster, or empty when it has none; a server
+// returns one result per cluster and the broker collapses clusters across servers.
+// The broker sends the global statistics with SEARCH, so every server scores documents
+// as a single index over the whole collection would. A request is answered entirely from
+// the snapshot that is current when it arrives.
+std::string handleRequest(const std::string& request) {
+    std::shared_ptr<const IndexSnapshot> snapshot = std::atomic_load(&currentSnapshot);
+
+    // Split on tabs, keeping empty fields such as an empty query
+    std::vector<std::string> fields;
+    size_t fieldStart = 0;
+    while (true) {
+        size_t tab = request.find('\t', fieldStart);
+        fields.push_back(request.substr(fieldStart, tab == std::string::npos ? std::string::npos : tab - fieldStart));
+        if (tab == std::string::npos) {
+            break;
+        }
+        fieldStart = tab + 1;
+    }
+
+    std::ostringstream response;
+    if (fields.size() == 2 && fields[0] == "STATS") {
+        int numDocs;
+        std::uint64_t totalDocumentLength;
+        localCollectionSize(*snapshot, numDocs, totalDocumentLength);
+        response << "STATS " << numDocs << " " << totalDocumentLength;
+        for (int docFrequency : localDocFrequencies(*snapshot, tokenizeQuery(*snapshot, fields[1]))) {
+            response << " " << docFrequency;
+        }
+        response << "\n";
+    } else if (fields.size() == 7 && fields[0] == "SEARCH") {
+        bool conjunctive = (fields[1] == "1");
+        int k = std::atoi(fields[2].c_str());
+        CollectionStats stats;
+        stats.totalDocuments = std::atoi(fields[3].c_str());
+        stats.avgDocumentLength = std::strtod(fields[4].c_str(), nullptr);
+        std::vector<int> docFrequencies;
+        std::istringstream dfStream(fields[5]);
+        int docFrequency;
+        while (dfStream >> docFrequency) {
+            docFrequencies.push_back(docFrequency);
+        }
+        std::vector<std::string> terms = tokenizeQuery(*snapshot, fields[6]);
+        if (k <= 0 || docFrequencies.size() != terms.size()) {
+            return "ERROR malformed SEARCH request\nEND\n";
+        }
+
+        std::vector<DocScore> results = searchShards(*snapshot, terms, docFrequencies, stats, conjunctive, k);
+        std::vector<Snippet> snippets = makeSnippets(*snapshot, results, terms);
+        char score[32];
+        for (size_t i = 0; i < results.size(); ++i) {
+            // Full precision so the broker merges and prints exactly what a local query would
+            std::snprintf(score, sizeof(score), "%.17g", results[i].score);
+            response << "RESULT\t" << results[i].docID << "\t" << score << "\t" << snippets[i].text << "\t";
+            for (size_t h = 0; h < snippets[i].highlights.size(); ++h) {
+                response << (h > 0 ? " " : "") << snippets[i].highlights[h].first << ":" << snippets[i].highlights[h].second;
+            }
+            response << "\t";
+            std::uint32_t clusterID = clusterOf(*snapshot, results[i].docID);
+            if (clusterID != NO_CLUSTER_ID) {
+                response << clusterID;
+            }
+            response << "\n";
+        }
+    } else {
+        return "ERROR unknown request\nEND\n";
+    }
+    response << "END\n";
+    return response.str();
+}
+
+// Where a server loads its index from, and how often it checks for a new generation
+struct ServeOptions {
+    std::string indexFilePath = DEFAULT_INDEX_FILE;
+    std::string lexiconFilePath = DEFAULT_LEXICON_FILE;
+    std::string collectionFilePath = "collection.tsv";
+    int onlyShard = -1;
+    // Poll the index files this often; 0 reloads only on SIGHUP
+    int reloadIntervalMs = 1000;
+};
+
+static volatile std::sig_atomic_t reloadRequested = 0;
 
-    collectionFile.open(collectionFilePath);
-    if (!collectionFile.is_open()) {
-        std::cerr << "Error opening collection file: " << collectionFilePath << std::endl;
+static void onReloadSignal(int) {
+    reloadRequested = 1;
+}
+
+// Identity of the files an index generation is loaded from: the manifest and, for every
+// index directory it lists, the index, lexicon, metadata, passages and deleted documents.
+// Rebuilds, reorders, segment flushes and merges, and deletions all replace at least one.
+std::string indexFingerprint(const ServeOptions& options) {
+    std::vector<std::string> files = { SHARD_MANIFEST_FILE };
+    std::vector<ShardInfo> shardInfos;
+    if (readShardManifest(SHARD_MANIFEST_FILE, shardInfos)) {
+        for (const ShardInfo& info : shardInfos) {
+            for (const char* name : { "final_inverted_index.bin", "lexicon.txt", "doc_metadata.bin", "doc_store.bin" }) {
+                files.push_back(info.directory + name);
+            }
+            files.push_back(info.directory + DELETED_DOCS_FILE_NAME);
+        }
+    } else {
+        files.push_back(options.indexFilePath);
+        files.push_back(options.lexiconFilePath);
+        files.push_back("tmp/doc_metadata.bin");
+        files.push_back("tmp/doc_store.bin");
+        files.push_back(std::string("tmp/") + DELETED_DOCS_FILE_NAME);
+    }
+
+    std::ostringstream fingerprint;
+    for (const std::string& file : files) {
+        struct stat fileStat;
+        fingerprint << file;
+        if (stat(file.c_str(), &fileStat) == 0) {
+            fingerprint << " " << fileStat.st_ino << " " << fileStat.st_size << " "
+                        << fileStat.st_mtim.tv_sec << "." << fileStat.st_mtim.tv_nsec;
+        }
+        fingerprint << "\n";
+    }
+    return fingerprint.str();
+}
+
+// Load a new generation, fault it into memory and publish it. Queries that already hold
+// the previous snapshot finish on it; new queries see the new one. Returns the published
+// snapshot, or nullptr if loading failed or the files changed while they were being read.
+std::shared_ptr<const IndexSnapshot> publishSnapshot(const ServeOptions& options, const std::string& fingerprint) {
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<IndexSnapshot> snapshot = loadSnapshot(options.indexFilePath, options.lexiconFilePath,
+                                                           options.collectionFilePath, options.onlyShard);
+    if (snapshot == nullptr) {
+        return nullptr;
+    }
+    if (indexFingerprint(options) != fingerprint) {
+        // A writer was still replacing files; the next poll retries once they settle
+        return nullptr;
+    }
+    // Warm before publishing, so the first queries on the new generation do not pay for
+    // page faults that the old one had long since absorbed
+    for (const auto& shard : snapshot->shards) {
+        shard->indexAPI->warm();
+        shard->docMetadata.warm();
+    }
+
+    std::shared_ptr<const IndexSnapshot> previous = std::atomic_load(&currentSnapshot);
+    snapshot->generation = previous != nullptr ? previous->generation + 1 : 1;
+    std::atomic_store(&currentSnapshot, std::shared_ptr<const IndexSnapshot>(snapshot));
+
+    int numDocs;
+    std::uint64_t totalDocumentLength;
+    localCollectionSize(*snapshot, numDocs, totalDocumentLength);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "[INFO] Index generation " << snapshot->generation << ": " << snapshot->shards.size()
+              << " shard(s), " << numDocs << " documents, loaded in " << elapsed.count() << " ms" << std::endl;
+    return snapshot;
+}
+
+// Background reloader. A new generation is loaded once the index files have changed and
+// then stayed unchanged for one poll interval, so a rebuild that is still writing its
+// files is not picked up half way; SIGHUP reloads at once. Replaced snapshots are kept
+// here until their last query finishes and are then freed on this thread, so unmapping
+// an old generation never adds latency to a query.
+void reloadSnapshots(ServeOptions options, std::string loadedFingerprint) {
+    std::string seenFingerprint = loadedFingerprint;
+    std::vector<std::shared_ptr<const IndexSnapshot>> retired;
+    auto lastPoll = std::chrono::steady_clock::now();
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+            [](const std::shared_ptr<const IndexSnapshot>& snapshot) { return snapshot.use_count() == 1; }),
+            retired.end());
+
+        bool forced = reloadRequested != 0;
+        auto now = std::chrono::steady_clock::now();
+        if (!forced && (options.reloadIntervalMs <= 0 || now - lastPoll < std::chrono::milliseconds(options.reloadIntervalMs))) {
+            continue;
+        }
+        lastPoll = now;
+        reloadRequested = 0;
+
+        std::string fingerprint = indexFingerprint(options);
+        bool settled = (fingerprint == seenFingerprint);
+        seenFingerprint = fingerprint;
+        if (!forced && (fingerprint == loadedFingerprint || !settled)) {
+            continue;
+        }
+
+        std::shared_ptr<const IndexSnapshot> previous = std::atomic_load(&currentSnapshot);
+        if (publishSnapshot(options, fingerprint) != nullptr) {
+            retired.push_back(std::move(previous));
+            loadedFingerprint = fingerprint;
+        } else if (indexFingerprint(options) == fingerprint) {
+            // The files are stable but unusable; do not retry them until they change again
+            std::cerr << "[WARN] Index reload failed; still serving generation " << previous->generation << std::endl;
+            loadedFingerprint = fingerprint;
+        }
+    }
+}
+
+// Serve broker requests on a TCP port, one request per connection and one thread per
+// connection. Snapshots are read-only, so requests run concurrently, and a background
+// thread swaps in new index generations without stopping the server.
+int serveQueries(const ServeOptions& options, int port) {
+    std::string fingerprint = indexFingerprint(options);
+    if (publishSnapshot(options, fingerprint) == nullptr) {
+        std::cerr << "Error loading the index" << std::endl;
+        return 1;
+    }
+    int listenFd = listenOn(port);
+    if (listenFd < 0) {
+        std::cerr << "Error listening on port " << port << std::endl;
+        return 1;
+    }
+    std::cout << "Serving " << std::atomic_load(&currentSnapshot)->shards.size() << " shard(s) on port " << port << std::endl;
+    std::signal(SIGHUP, onReloadSignal);
+    std::thread(reloadSnapshots, options, fingerprint).detach();
+
+    while (true) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        std::thread([fd]() {
+            // A client gets a few seconds to send its request and read the response
+            Deadline deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            std::string buffer, request;
+            if (readLine(fd, buffer, request, deadline)) {
+                sendAll(fd, handleRequest(request), std::chrono::steady_clock::now() + std::chrono::seconds(10));
+            }
+            closeSocket(fd);
+        }).detach();
+    }
+}
+
+void startQueryProcessor(const std::string& indexFilePath, const std::string& lexiconFilePath, const std::string& collectionFilePath, const std::string& query, const std::string& mode) {
+    std::shared_ptr<IndexSnapshot> snapshot = loadSnapshot(indexFilePath, lexiconFilePath, collectionFilePath, -1);
+    if (snapshot == nullptr) {
         return;
     }
 
-    IndexAPI indexAPI(indexFilePath, lexiconFilePath);
+    // Every shard is loaded here, so the local statistics are the global ones
+    CollectionStats stats;
+    std::uint64_t totalDocumentLength;
+    localCollectionSize(*snapshot, stats.totalDocuments, totalDocumentLength);
+    stats.avgDocumentLength = stats.totalDocuments > 0 ? static_cast<double>(totalDocumentLength) / stats.totalDocuments : 0.0;
 
     bool conjunctive = (mode == "1");
 
-    std::vector<std::string> terms = tokenizeQuery(query);
+    std::vector<std::string> terms = tokenizeQuery(*snapshot, query);
     if (terms.empty()) {
         std::cout << "No terms found in query." << std::endl;
         return;
     }
 
+    // Global document frequencies are the sums over all shards
+    std::vector<int> docFrequencies = localDocFrequencies(*snapshot, terms);
+    bool anyFound = false;
+    bool allFound = true;
+    for (int docFrequency : docFrequencies) {
+        anyFound = anyFound || docFrequency > 0;
+        allFound = allFound && docFrequency > 0;
+    }
+    if (conjunctive ? !allFound : !anyFound) {
+        std::cout << "No matching documents found." << std::endl;
+        return;
+    }
+
     const int k = 10; // Number of top documents to return
 
-    if (conjunctive) {
-        processConjunctiveQuery(terms, indexAPI, k);
-    } else {
-        processDisjunctiveQuery(terms, indexAPI, k);
-    }
+    std::vector<DocScore> results = searchShards(*snapshot, terms, docFrequencies, stats, conjunctive, k);
+    printResults(*snapshot, results, terms, k);
+}
 
-    collectionFile.close();
+// Handle --stem or --stopwords=POLICY. Returns false for any other argument, with status 0,
+// or for a stopword file that cannot be read, with status 1.
+bool parseAnalysisOption(const std::string& arg, TextAnalysis& analysis, int& status) {
+    status = 0;
+    if (arg == "--stem") {
+        analysis.stem = true;
+        queryAnalysisGiven = true;
+        return true;
+    }
+    if (arg.compare(0, 12, "--stopwords=") == 0) {
+        if (loadStopwords(arg.substr(12), analysis)) {
+            queryAnalysisGiven = true;
+            return true;
+        }
+        status = 1;
+    }
+    return false;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 6) {
-        std::cerr << "Usage: " << argv[0] << " indexFilePath lexiconFilePath collectionFilePath query mode" << std::endl;
+    int status = 0;
+    // Server mode: answer broker requests for one shard (or the whole index) over TCP
+    if (argc >= 2 && std::string(argv[1]).compare(0, 8, "--serve=") == 0) {
+        int port = 0;
+        ServeOptions options;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.compare(0, 8, "--serve=") == 0) {
+                port = std::stoi(arg.substr(8));
+            } else if (arg.compare(0, 8, "--shard=") == 0) {
+                options.onlyShard = std::stoi(arg.substr(8));
+            } else if (arg.compare(0, 13, "--collection=") == 0) {
+                options.collectionFilePath = arg.substr(13);
+            } else if (arg.compare(0, 12, "--reload-ms=") == 0) {
+                options.reloadIntervalMs = std::stoi(arg.substr(12));
+            } else if (!parseAnalysisOption(arg, queryAnalysis, status)) {
+                if (status == 0) {
+                    std::cerr << "Usage: " << argv[0] << " --serve=PORT [--shard=N] [--collection=FILE] [--reload-ms=N]"
+                              << " [--stem] [--stopwords=none|english|FILE]" << std::endl;
+                }
+                return 1;
+            }
+        }
+        return serveQueries(options, port);
+    }
+
+    // Text analysis options follow the positional arguments
+    bool usage = argc < 6;
+    for (int i = 6; !usage && i < argc; ++i) {
+        if (!parseAnalysisOption(argv[i], queryAnalysis, status)) {
+            if (status != 0) {
+                return 1;
+            }
+            usage = true;
+        }
+    }
+    if (usage) {
+        std::cerr << "Usage: " << argv[0] << " indexFilePath lexiconFilePath collectionFilePath query mode"
+                  << " [--stem] [--stopwords=none|english|FILE]" << std::endl;
+        std::cerr << "       " << argv[0] << " --serve=PORT [--shard=N] [--collection=FILE] [--reload-ms=N]"
+                  << " [--stem] [--stopwords=none|english|FILE]" << std::endl;
         return 1;
     }
 
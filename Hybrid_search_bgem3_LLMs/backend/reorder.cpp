@@ -0,0 +1,371 @@
+#include "reorder.h"
+#include "index_writer.h"
+#include "index_api.h"
+#include "doc_store.h"
+#include "collection_reader.h"
+#include "tokenizer.h"
+#include "index_scanner.h"
+#include "deleted_docs.h"
+#include "shards.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <sys/stat.h>
+
+static std::uint64_t mixHash(std::uint64_t value) {
+    // splitmix64 finalizer
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+static std::uint64_t hashTerm(const std::string& term) {
+    // FNV-1a
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    for (unsigned char c : term) {
+        hash = (hash ^ c) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+std::vector<int> computeMinHashOrder(const std::string& indexFile, const std::string& lexiconFile, const DocMetadata& metadata,
+                                     int numHashes) {
+    int numDocs = static_cast<int>(metadata.numDocs());
+    std::vector<std::uint32_t> signatures(static_cast<size_t>(numDocs) * numHashes, UINT32_MAX);
+
+    IndexScanner scanner;
+    if (!scanner.open(indexFile, lexiconFile, numDocs)) {
+        std::cerr << "Error: Unable to open index file: " << indexFile << std::endl;
+        return {};
+    }
+
+    // Terms in a single document link nothing, and very common terms link everything
+    int maxDocFrequency = std::max(2, numDocs / 10);
+    std::string term;
+    std::vector<int> docIDs;
+    std::vector<int> freqs;
+    std::vector<std::uint32_t> termHashes(numHashes);
+    while (scanner.next(term, docIDs, freqs)) {
+        int docFrequency = static_cast<int>(docIDs.size());
+        if (docFrequency < 2 || docFrequency > maxDocFrequency) {
+            continue;
+        }
+        std::uint64_t base = hashTerm(term);
+        for (int h = 0; h < numHashes; ++h) {
+            termHashes[h] = static_cast<std::uint32_t>(mixHash(base + h));
+        }
+        for (int docID : docIDs) {
+            std::uint32_t* signature = &signatures[static_cast<size_t>(docID) * numHashes];
+            for (int h = 0; h < numHashes; ++h) {
+                signature[h] = std::min(signature[h], termHashes[h]);
+            }
+        }
+    }
+    if (scanner.failed()) {
+        return {};
+    }
+
+    // Sort by signature; documents with equal signatures keep their relative order
+    std::vector<int> order(numDocs);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        const std::uint32_t* signatureA = &signatures[static_cast<size_t>(a) * numHashes];
+        const std::uint32_t* signatureB = &signatures[static_cast<size_t>(b) * numHashes];
+        return std::lexicographical_compare(signatureA, signatureA + numHashes, signatureB, signatureB + numHashes);
+    });
+    return order;
+}
+
+// Rewrite every posting list with docIDs mapped through oldToNew; documents mapped to -1
+// are dropped, along with terms left without postings
+static bool rewriteIndex(const std::string& indexFile, const std::string& lexiconFile, const std::string& outputIndexFile,
+                         const std::string& outputLexiconFile, const std::vector<int>& oldToNew) {
+    IndexScanner scanner;
+    if (!scanner.open(indexFile, lexiconFile, static_cast<int>(oldToNew.size()))) {
+        std::cerr << "Error: Unable to open index file: " << indexFile << std::endl;
+        return false;
+    }
+    AsyncFileWriter outFile;
+    AsyncFileWriter lexiconOut;
+    if (!outFile.open(outputIndexFile) || !lexiconOut.open(outputLexiconFile)) {
+        std::cerr << "Error: Unable to open output files for the reordered index." << std::endl;
+        return false;
+    }
+
+    PostingListWriter writer(outFile, lexiconOut);
+    std::string term;
+    std::vector<int> docIDs;
+    std::vector<int> freqs;
+    std::vector<std::pair<int, int>> postings;
+    while (scanner.next(term, docIDs, freqs)) {
+        postings.clear();
+        for (size_t i = 0; i < docIDs.size(); ++i) {
+            if (oldToNew[docIDs[i]] >= 0) {
+                postings.emplace_back(oldToNew[docIDs[i]], freqs[i]);
+            }
+        }
+        if (postings.empty()) {
+            continue;
+        }
+        std::sort(postings.begin(), postings.end());
+
+        writer.beginTerm(term);
+        for (const auto& posting : postings) {
+            writer.addPosting(posting.first, posting.second);
+        }
+        writer.endTerm();
+    }
+    // A scan that stopped early would leave out the rest of the index
+    if (scanner.failed()) {
+        return false;
+    }
+
+    bool indexOk = outFile.close();
+    bool lexiconOk = lexiconOut.close();
+    return indexOk && lexiconOk;
+}
+
+// Rewrite the document metadata and document store in the new docID order. Passages are
+// copied from the existing document store, which holds them whatever format the parser
+// read; only an index built before the store existed falls back to the raw collection.
+static bool rewriteDocuments(const ReorderOptions& options, const DocMetadata& metadata, const std::vector<int>& newToOld,
+                             const std::string& outputMetadataFile, const std::string& outputDocStoreFile) {
+    DocStore docStoreIn;
+    CollectionReader collection;
+    if (docStoreIn.open(options.docStoreFile)) {
+        if (docStoreIn.numDocs() != metadata.numDocs()) {
+            std::cerr << "Error: " << options.docStoreFile << " does not match " << options.metadataFile << std::endl;
+            return false;
+        }
+    } else if (!collection.open(options.collectionFile, metadata)) {
+        std::cerr << "Error opening collection file: " << options.collectionFile << std::endl;
+        return false;
+    }
+    DocStoreWriter docStore;
+    if (!docStore.open(outputDocStoreFile)) {
+        return false;
+    }
+
+    DocMetadataBuilder builder;
+    builder.setAnalysis(metadata.analysis());
+    for (int oldDocID : newToOld) {
+        builder.addDocument(metadata.passageID(oldDocID), metadata.length(oldDocID), metadata.offset(oldDocID),
+                            metadata.clusterID(oldDocID));
+    }
+
+    // Fetch in batches so each store block or collection range is read once per batch
+    const size_t BATCH_SIZE = 4096;
+    for (size_t begin = 0; begin < newToOld.size(); begin += BATCH_SIZE) {
+        std::vector<int> batch(newToOld.begin() + begin, newToOld.begin() + std::min(begin + BATCH_SIZE, newToOld.size()));
+        std::vector<std::string> passages = docStoreIn.is_open() ? docStoreIn.getPassages(batch) : collection.getPassages(batch);
+        for (const std::string& passage : passages) {
+            docStore.addPassage(passage);
+        }
+    }
+
+    bool storeOk = docStore.close();
+    return builder.write(outputMetadataFile) && storeOk;
+}
+
+static std::uint64_t fileSize(const std::string& filePath) {
+    struct stat fileStat;
+    if (stat(filePath.c_str(), &fileStat) != 0) {
+        return 0;
+    }
+    return static_cast<std::uint64_t>(fileStat.st_size);
+}
+
+// Average milliseconds to evaluate each query conjunctively and disjunctively, walking the
+// posting lists with nextGEQ as the query processor does (without scoring). Queries are
+// analyzed the way the index was.
+static void timeQueries(const std::string& indexFile, const std::string& lexiconFile, const TextAnalysis& analysis,
+                        const std::vector<std::string>& queries, double& conjunctiveMs, double& disjunctiveMs) {
+    IndexAPI indexAPI(indexFile, lexiconFile);
+    Tokenizer tokenizer(analysis);
+    double conjunctiveTotal = 0.0;
+    double disjunctiveTotal = 0.0;
+
+    for (const std::string& query : queries) {
+        std::vector<std::string> terms;
+        for (std::string_view token : tokenizer.tokenize(query)) {
+            terms.emplace_back(token);
+        }
+
+        // Conjunctive: advance every list to the largest current docID until they agree
+        auto start = std::chrono::steady_clock::now();
+        std::vector<InvertedList*> lists;
+        bool missing = false;
+        for (const std::string& term : terms) {
+            InvertedList* list = indexAPI.openList(term);
+            if (list == nullptr) {
+                missing = true;
+                break;
+            }
+            lists.push_back(list);
+        }
+        if (!missing && !lists.empty()) {
+            int did = 0;
+            while (did != INT32_MAX) {
+                int candidate = did;
+                bool agreed = true;
+                for (InvertedList* list : lists) {
+                    int d = list->nextGEQ(candidate);
+                    if (d != candidate) {
+                        candidate = d;
+                        agreed = false;
+                        break;
+                    }
+                }
+                did = agreed ? candidate + 1 : candidate;
+                if (candidate == INT32_MAX) {
+                    break;
+                }
+            }
+        }
+        for (InvertedList* list : lists) {
+            indexAPI.closeList(list);
+        }
+        conjunctiveTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // Disjunctive: visit every posting of every list
+        start = std::chrono::steady_clock::now();
+        for (const std::string& term : terms) {
+            InvertedList* list = indexAPI.openList(term);
+            if (list == nullptr) {
+                continue;
+            }
+            for (int d = list->nextGEQ(0); d != INT32_MAX; d = list->nextGEQ(d + 1)) {
+            }
+            indexAPI.closeList(list);
+        }
+        disjunctiveTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    size_t numQueries = std::max<size_t>(1, queries.size());
+    conjunctiveMs = conjunctiveTotal / numQueries;
+    disjunctiveMs = disjunctiveTotal / numQueries;
+}
+
+bool reorderIndex(const ReorderOptions& options) {
+    DocMetadata metadata;
+    if (!metadata.open(options.metadataFile)) {
+        return false;
+    }
+    TextAnalysis analysis;
+    if (!TextAnalysis::fromDescription(metadata.analysis(), analysis)) {
+        std::cerr << "Error: Unrecognized text analysis in " << options.metadataFile << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> queries;
+    if (!options.queriesFile.empty()) {
+        std::ifstream queriesIn(options.queriesFile);
+        if (!queriesIn.is_open()) {
+            std::cerr << "Error opening queries file: " << options.queriesFile << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(queriesIn, line)) {
+            if (!line.empty()) {
+                queries.push_back(line);
+            }
+        }
+    }
+
+    double conjunctiveBefore = 0.0, disjunctiveBefore = 0.0;
+    if (!queries.empty()) {
+        timeQueries(options.indexFile, options.lexiconFile, analysis, queries, conjunctiveBefore, disjunctiveBefore);
+    }
+
+    std::cout << "[INFO] Computing MinHash docID order..." << std::endl;
+    std::vector<int> newToOld = computeMinHashOrder(options.indexFile, options.lexiconFile, metadata, std::max(1, options.numHashes));
+    if (newToOld.size() != metadata.numDocs()) {
+        return false;
+    }
+    // Deleted documents are dropped from the rewritten index
+    DeletedDocs deletedDocs;
+    if (!deletedDocs.load(options.deletedDocsFile, metadata.numDocs())) {
+        return false;
+    }
+    newToOld.erase(std::remove_if(newToOld.begin(), newToOld.end(), [&](int oldDocID) { return deletedDocs.isDeleted(oldDocID); }),
+                   newToOld.end());
+    std::vector<int> oldToNew(metadata.numDocs(), -1);
+    for (size_t newDocID = 0; newDocID < newToOld.size(); ++newDocID) {
+        oldToNew[newToOld[newDocID]] = static_cast<int>(newDocID);
+    }
+
+    // Write everything next to the originals and only replace them once all succeeded
+    std::string suffix = ".reordered";
+    std::cout << "[INFO] Rewriting index with new docIDs..." << std::endl;
+    if (!rewriteIndex(options.indexFile, options.lexiconFile, options.indexFile + suffix, options.lexiconFile + suffix, oldToNew) ||
+        !rewriteDocuments(options, metadata, newToOld, options.metadataFile + suffix, options.docStoreFile + suffix)) {
+        std::cerr << "Error: Reordering failed; the original index was left unchanged." << std::endl;
+        return false;
+    }
+    std::uint64_t numDocs = metadata.numDocs();
+    metadata.close();
+
+    std::uint64_t sizeBefore = fileSize(options.indexFile);
+    std::uint64_t sizeAfter = fileSize(options.indexFile + suffix);
+    double conjunctiveAfter = 0.0, disjunctiveAfter = 0.0;
+    if (!queries.empty()) {
+        timeQueries(options.indexFile + suffix, options.lexiconFile + suffix, analysis, queries, conjunctiveAfter, disjunctiveAfter);
+    }
+
+    const std::string* files[] = {&options.indexFile, &options.lexiconFile, &options.metadataFile, &options.docStoreFile};
+    auto discardOutputs = [&]() {
+        for (const std::string* file : files) {
+            std::remove((*file + suffix).c_str());
+        }
+    };
+
+    // Deletions and segment merges are blocked until the manifest matches the new files
+    ManifestLock manifestLock;
+    if (!manifestLock.locked()) {
+        discardOutputs();
+        return false;
+    }
+    // A document deleted since the bitmap was read is still in the rewritten index, and its
+    // tombstone names an old docID
+    DeletedDocs currentDeletions;
+    if (!currentDeletions.load(options.deletedDocsFile, numDocs) || currentDeletions.numDeleted() != deletedDocs.numDeleted()) {
+        std::cerr << "Error: Documents were deleted while reordering; the original index was left unchanged." << std::endl;
+        discardOutputs();
+        return false;
+    }
+    for (const std::string* file : files) {
+        if (std::rename((*file + suffix).c_str(), file->c_str()) != 0) {
+            std::cerr << "Error: Unable to replace " << *file << std::endl;
+            return false;
+        }
+    }
+    if (deletedDocs.numDeleted() > 0) {
+        std::remove(options.deletedDocsFile.c_str());
+        std::cout << "[INFO] Dropped " << deletedDocs.numDeleted() << " deleted documents" << std::endl;
+        // Keep the document count in the manifest in step when the index is part of one
+        std::vector<ShardInfo> shards;
+        if (readShardManifest(SHARD_MANIFEST_FILE, shards)) {
+            for (ShardInfo& shard : shards) {
+                if (shard.directory + "doc_metadata.bin" == options.metadataFile) {
+                    shard.numDocs = static_cast<int>(newToOld.size());
+                }
+            }
+            writeShardManifest(SHARD_MANIFEST_FILE, shards);
+        }
+    }
+
+    std::cout << "[INFO] Index size: " << sizeBefore << " -> " << sizeAfter << " bytes ("
+              << (sizeBefore > 0 ? 100.0 * sizeAfter / sizeBefore : 0.0) << "%)" << std::endl;
+    if (!queries.empty()) {
+        std::cout << "[INFO] Avg conjunctive traversal: " << conjunctiveBefore << " -> " << conjunctiveAfter << " ms" << std::endl;
+        std::cout << "[INFO] Avg disjunctive traversal: " << disjunctiveBefore << " -> " << disjunctiveAfter << " ms" << std::endl;
+    }
+    return true;
+}
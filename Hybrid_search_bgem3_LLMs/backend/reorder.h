@@ -0,0 +1,37 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <string>
+#include <vector>
+#include "doc_metadata.h"
+
+// Options for reassigning docIDs in a built index
+struct ReorderOptions {
+    std::string indexFile = "tmp/final_inverted_index.bin";
+    std::string lexiconFile = "tmp/lexicon.txt";
+    std::string metadataFile = "tmp/doc_metadata.bin";
+    std::string docStoreFile = "tmp/doc_store.bin";
+    // Documents marked here are dropped from the reordered index (see deleted_docs.h)
+    std::string deletedDocsFile = "tmp/deleted_docs.bin";
+    // Only read for an index without a document store
+    std::string collectionFile = "collection.tsv";
+    // Optional file with one query per line, timed against the index before and after
+    std::string queriesFile;
+    // MinHash functions per document; more hashes break more ties between clusters
+    int numHashes = 4;
+};
+
+// Compute a docID order that places documents with similar term sets next to each other.
+// Each document gets a MinHash signature over its terms (ignoring terms too rare or too
+// common to say anything about similarity) and documents are sorted by signature.
+// Returns the old docID for each new docID.
+std::vector<int> computeMinHashOrder(const std::string& indexFile, const std::string& lexiconFile, const DocMetadata& metadata,
+                                     int numHashes);
+
+// Renumber the documents of an index and rewrite the index, lexicon, document metadata and
+// document store in the new order. Passage IDs move with their documents, so results still
+// resolve to the same passages. Deleted documents are dropped. Prints index sizes and, with
+// a queries file, average query latency before and after.
+bool reorderIndex(const ReorderOptions& options);
+
+#endif // REORDER_H
@@ -0,0 +1,66 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include "reorder.h"
+#include "deleted_docs.h"
+#include "shards.h"
+
+// Point every index file at one index directory (single index, shard or segment)
+static void setIndexDirectory(ReorderOptions& options, const std::string& directory) {
+    options.indexFile = directory + "final_inverted_index.bin";
+    options.lexiconFile = directory + "lexicon.txt";
+    options.metadataFile = directory + "doc_metadata.bin";
+    options.docStoreFile = directory + "doc_store.bin";
+    options.deletedDocsFile = directory + DELETED_DOCS_FILE_NAME;
+}
+
+int main(int argc, char* argv[]) {
+    ReorderOptions options;
+    std::string directory;
+
+    // Optional flags: --dir=DIR reorders only the index in DIR, --collection=PATH locates
+    // collection.tsv for an index without a document store, --queries=PATH times the
+    // queries in a file before and after, --hashes=N sets the MinHash signature size
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 6, "--dir=") == 0) {
+            directory = arg.substr(6);
+            if (!directory.empty() && directory.back() != '/') {
+                directory += '/';
+            }
+        } else if (arg.compare(0, 13, "--collection=") == 0) {
+            options.collectionFile = arg.substr(13);
+        } else if (arg.compare(0, 10, "--queries=") == 0) {
+            options.queriesFile = arg.substr(10);
+        } else if (arg.compare(0, 9, "--hashes=") == 0) {
+            options.numHashes = std::max(1, std::stoi(arg.substr(9)));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--dir=DIR] [--collection=PATH] [--queries=PATH] [--hashes=N]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    if (!directory.empty()) {
+        setIndexDirectory(options, directory);
+        return reorderIndex(options) ? 0 : 1;
+    }
+
+    // A sharded or segmented index is reordered one directory at a time
+    std::vector<ShardInfo> shards;
+    if (readShardManifest(SHARD_MANIFEST_FILE, shards)) {
+        for (const ShardInfo& shard : shards) {
+            ReorderOptions shardOptions = options;
+            setIndexDirectory(shardOptions, shard.directory);
+            std::cout << "[INFO] Reordering " << shard.directory << std::endl;
+            if (!reorderIndex(shardOptions)) {
+                std::cerr << "Error: Reordering " << shard.directory << " failed." << std::endl;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    return reorderIndex(options) ? 0 : 1;
+}
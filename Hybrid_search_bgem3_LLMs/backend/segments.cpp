@@ -0,0 +1,408 @@
+#include "segments.h"
+#include "index_writer.h"
+#include "index_scanner.h"
+#include "doc_store.h"
+#include "deleted_docs.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Files of a segment directory, in the shard layout
+static const char* const SEGMENT_FILES[] = { "final_inverted_index.bin", "lexicon.txt", "doc_metadata.bin", "doc_store.bin",
+                                              "deleted_docs.bin" };
+static const std::string SEGMENT_PREFIX = "tmp/segment_";
+
+SegmentBuilder::SegmentBuilder(const TextAnalysis& analysis) : tokenizer(analysis), analysis(analysis.describe()) {
+    metadata.setAnalysis(this->analysis);
+}
+
+void SegmentBuilder::addDocument(std::string_view passageID, std::string_view text, std::uint64_t offset) {
+    int docID = numDocs();
+    const std::vector<std::string_view>& tokens = tokenizer.tokenize(text);
+
+    std::unordered_map<std::string_view, int> termCounts;
+    for (std::string_view token : tokens) {
+        termCounts[token]++;
+    }
+    for (const auto& termCount : termCounts) {
+        postings[std::string(termCount.first)].emplace_back(docID, termCount.second);
+    }
+
+    metadata.addDocument(passageID, static_cast<std::uint32_t>(tokens.size()), offset);
+    passages.emplace_back(text);
+}
+
+bool SegmentBuilder::write(const std::string& directory) {
+    AsyncFileWriter outFile;
+    AsyncFileWriter lexiconOut;
+    if (!outFile.open(directory + "final_inverted_index.bin") || !lexiconOut.open(directory + "lexicon.txt")) {
+        std::cerr << "Error: Unable to open segment files for writing in " << directory << std::endl;
+        return false;
+    }
+
+    // Lists in lexicon order, written as the merger would write them
+    std::vector<const std::pair<const std::string, std::vector<std::pair<int, int>>>*> terms;
+    terms.reserve(postings.size());
+    for (const auto& entry : postings) {
+        terms.push_back(&entry);
+    }
+    std::sort(terms.begin(), terms.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+    PostingListWriter writer(outFile, lexiconOut);
+    for (const auto* entry : terms) {
+        writer.beginTerm(entry->first);
+        for (const auto& posting : entry->second) {
+            writer.addPosting(posting.first, posting.second);
+        }
+        writer.endTerm();
+    }
+    bool indexWritten = outFile.close();
+    bool lexiconWritten = lexiconOut.close();
+
+    DocStoreWriter docStore;
+    bool storeWritten = docStore.open(directory + "doc_store.bin");
+    for (const std::string& passage : passages) {
+        docStore.addPassage(passage);
+    }
+    storeWritten = storeWritten && docStore.close();
+    bool metadataWritten = metadata.write(directory + "doc_metadata.bin");
+    // A new segment has no deletions, whatever an abandoned directory of the same name held
+    std::remove((directory + DELETED_DOCS_FILE_NAME).c_str());
+    if (!indexWritten || !lexiconWritten || !storeWritten || !metadataWritten) {
+        return false;
+    }
+
+    postings.clear();
+    metadata = DocMetadataBuilder();
+    metadata.setAnalysis(analysis);
+    passages.clear();
+    return true;
+}
+
+bool mergeSegments(const std::vector<ShardInfo>& segments, const std::string& directory,
+                   std::vector<std::vector<int>>& docIDMaps) {
+    // Number the live documents of all segments consecutively; deleted documents are dropped
+    std::vector<DocMetadata> metadata(segments.size());
+    docIDMaps.assign(segments.size(), std::vector<int>());
+    int numDocs = 0;
+    for (size_t s = 0; s < segments.size(); ++s) {
+        DeletedDocs deletedDocs;
+        if (!metadata[s].open(segments[s].directory + "doc_metadata.bin") ||
+            !deletedDocs.load(segments[s].directory + DELETED_DOCS_FILE_NAME, metadata[s].numDocs())) {
+            std::cerr << "Error: Unable to open document files in " << segments[s].directory << std::endl;
+            return false;
+        }
+        if (metadata[s].analysis() != metadata[0].analysis()) {
+            std::cerr << "Error: " << segments[s].directory << " was indexed with different stemming or stopwords" << std::endl;
+            return false;
+        }
+        docIDMaps[s].resize(metadata[s].numDocs());
+        for (size_t docID = 0; docID < docIDMaps[s].size(); ++docID) {
+            docIDMaps[s][docID] = deletedDocs.isDeleted(static_cast<int>(docID)) ? -1 : numDocs++;
+        }
+    }
+
+    // Merge the posting lists term by term, in the new numbering
+    std::vector<IndexScanner> scanners(segments.size());
+    std::vector<std::string> terms(segments.size());
+    std::vector<std::vector<int>> docIDs(segments.size());
+    std::vector<std::vector<int>> freqs(segments.size());
+    std::vector<bool> hasTerm(segments.size(), false);
+    for (size_t s = 0; s < segments.size(); ++s) {
+        if (!scanners[s].open(segments[s].directory + "final_inverted_index.bin", segments[s].directory + "lexicon.txt",
+                              static_cast<int>(metadata[s].numDocs()))) {
+            std::cerr << "Error: Unable to open index file in " << segments[s].directory << std::endl;
+            return false;
+        }
+        hasTerm[s] = scanners[s].next(terms[s], docIDs[s], freqs[s]);
+    }
+
+    AsyncFileWriter outFile;
+    AsyncFileWriter lexiconOut;
+    if (!outFile.open(directory + "final_inverted_index.bin") || !lexiconOut.open(directory + "lexicon.txt")) {
+        std::cerr << "Error: Unable to open segment files for writing in " << directory << std::endl;
+        return false;
+    }
+    PostingListWriter writer(outFile, lexiconOut);
+    std::vector<std::pair<int, int>> postings;
+    while (true) {
+        const std::string* smallest = nullptr;
+        for (size_t s = 0; s < segments.size(); ++s) {
+            if (hasTerm[s] && (smallest == nullptr || terms[s] < *smallest)) {
+                smallest = &terms[s];
+            }
+        }
+        if (smallest == nullptr) {
+            break;
+        }
+        std::string term = *smallest;
+        postings.clear();
+        for (size_t s = 0; s < segments.size(); ++s) {
+            if (hasTerm[s] && terms[s] == term) {
+                for (size_t i = 0; i < docIDs[s].size(); ++i) {
+                    int docID = docIDMaps[s][docIDs[s][i]];
+                    if (docID >= 0) {
+                        postings.emplace_back(docID, freqs[s][i]);
+                    }
+                }
+                hasTerm[s] = scanners[s].next(terms[s], docIDs[s], freqs[s]);
+            }
+        }
+        // A term only the deleted documents had disappears from the lexicon
+        if (postings.empty()) {
+            continue;
+        }
+        writer.beginTerm(term);
+        for (const auto& posting : postings) {
+            writer.addPosting(posting.first, posting.second);
+        }
+        writer.endTerm();
+    }
+    // A scan that stopped early would leave out the rest of the segment
+    for (size_t s = 0; s < segments.size(); ++s) {
+        if (scanners[s].failed()) {
+            return false;
+        }
+    }
+    bool indexWritten = outFile.close();
+    bool lexiconWritten = lexiconOut.close();
+
+    // Concatenate the metadata and passages of the live documents
+    DocMetadataBuilder metadataOut;
+    metadataOut.setAnalysis(metadata[0].analysis());
+    DocStoreWriter docStoreOut;
+    bool storeWritten = docStoreOut.open(directory + "doc_store.bin");
+    for (size_t s = 0; s < segments.size(); ++s) {
+        DocStore segmentStore;
+        if (!segmentStore.open(segments[s].directory + "doc_store.bin")) {
+            std::cerr << "Error: Unable to open document store in " << segments[s].directory << std::endl;
+            return false;
+        }
+        for (int docID = 0; docID < static_cast<int>(docIDMaps[s].size()); ++docID) {
+            if (docIDMaps[s][docID] >= 0) {
+                metadataOut.addDocument(metadata[s].passageID(docID), metadata[s].length(docID), metadata[s].offset(docID),
+                                        metadata[s].clusterID(docID));
+                docStoreOut.addPassage(segmentStore.getPassage(docID));
+            }
+        }
+    }
+    storeWritten = storeWritten && docStoreOut.close();
+    bool metadataWritten = metadataOut.write(directory + "doc_metadata.bin");
+    std::remove((directory + DELETED_DOCS_FILE_NAME).c_str());
+    return indexWritten && lexiconWritten && storeWritten && metadataWritten;
+}
+
+// Carry deletions made while segments were being merged over to the merged segment
+static bool carryDeletions(const std::vector<ShardInfo>& inputs, const std::vector<std::vector<int>>& docIDMaps,
+                           const ShardInfo& output) {
+    DeletedDocs outputDeleted;
+    outputDeleted.load(output.directory + DELETED_DOCS_FILE_NAME, output.numDocs);
+    for (size_t s = 0; s < inputs.size(); ++s) {
+        DocMetadata metadata;
+        DeletedDocs deletedDocs;
+        if (!metadata.open(inputs[s].directory + "doc_metadata.bin") ||
+            !deletedDocs.load(inputs[s].directory + DELETED_DOCS_FILE_NAME, metadata.numDocs())) {
+            return false;
+        }
+        for (int docID = 0; docID < static_cast<int>(docIDMaps[s].size()); ++docID) {
+            if (docIDMaps[s][docID] >= 0 && deletedDocs.isDeleted(docID)) {
+                outputDeleted.markDeleted(docIDMaps[s][docID], metadata.length(docID));
+            }
+        }
+    }
+    return outputDeleted.numDeleted() == 0 || outputDeleted.write(output.directory + DELETED_DOCS_FILE_NAME);
+}
+
+SegmentManager::SegmentManager(const SegmentOptions& options)
+    : options(options), nextSegment(0), stopping(false) {
+    this->options.flushDocs = std::max(1, options.flushDocs);
+    this->options.mergeFactor = std::max(2, options.mergeFactor);
+}
+
+SegmentManager::~SegmentManager() {
+    close();
+}
+
+bool SegmentManager::open() {
+    ManifestLock manifestLock;
+    if (!readShardManifest(SHARD_MANIFEST_FILE, segments)) {
+        // Start from the parser's single index, if there is one
+        segments.clear();
+        DocMetadata metadata;
+        if (metadata.open("tmp/doc_metadata.bin")) {
+            segments.push_back({ "tmp/", 0, static_cast<int>(metadata.numDocs()) });
+        }
+        if (!writeShardManifest(SHARD_MANIFEST_FILE, segments)) {
+            return false;
+        }
+    }
+    // The index's first directory tells how its tokens were analyzed
+    analysis = TextAnalysis();
+    if (!segments.empty()) {
+        DocMetadata metadata;
+        if (!metadata.open(segments[0].directory + "doc_metadata.bin")) {
+            return false;
+        }
+        if (!TextAnalysis::fromDescription(metadata.analysis(), analysis)) {
+            std::cerr << "Error: Unrecognized text analysis in " << segments[0].directory << "doc_metadata.bin" << std::endl;
+            return false;
+        }
+    }
+    for (const ShardInfo& segment : segments) {
+        if (isIncremental(segment)) {
+            nextSegment = std::max(nextSegment, std::stoi(segment.directory.substr(SEGMENT_PREFIX.size())) + 1);
+        }
+    }
+    stopping = false;
+    mergeThread = std::thread(&SegmentManager::runMerges, this);
+    return true;
+}
+
+int SegmentManager::nextDocID() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return segments.empty() ? 0 : segments.back().docIDBase + segments.back().numDocs;
+}
+
+bool SegmentManager::flush(SegmentBuilder& builder) {
+    if (builder.numDocs() == 0) {
+        return true;
+    }
+    std::string directory;
+    int docIDBase;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        directory = newSegmentDirectory();
+        docIDBase = segments.empty() ? 0 : segments.back().docIDBase + segments.back().numDocs;
+    }
+
+    // Segment files are complete before the manifest makes them visible
+    int numDocs = builder.numDocs();
+    if (!builder.write(directory)) {
+        return false;
+    }
+
+    ManifestLock manifestLock;
+    std::lock_guard<std::mutex> lock(mutex);
+    segments.push_back({ directory, docIDBase, numDocs });
+    bool published = writeShardManifest(SHARD_MANIFEST_FILE, segments);
+    changed.notify_all();
+    std::cout << "[INFO] Flushed " << numDocs << " documents to " << directory << std::endl;
+    return published;
+}
+
+void SegmentManager::close() {
+    if (!mergeThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        changed.notify_all();
+    }
+    mergeThread.join();
+    removeRetired(true);
+}
+
+bool SegmentManager::isIncremental(const ShardInfo& segment) {
+    return segment.directory.compare(0, SEGMENT_PREFIX.size(), SEGMENT_PREFIX) == 0;
+}
+
+int SegmentManager::tier(const ShardInfo& segment) const {
+    // Tier t holds segments of about flushDocs * mergeFactor^t documents
+    int size = segment.numDocs / options.flushDocs;
+    int level = 0;
+    while (size >= options.mergeFactor) {
+        size /= options.mergeFactor;
+        level++;
+    }
+    return level;
+}
+
+int SegmentManager::findMerge() const {
+    // Prefer the lowest tier: small merges are cheap and keep the segment count down
+    int best = -1;
+    int bestTier = 0;
+    int numSegments = static_cast<int>(segments.size());
+    for (int first = 0; first + options.mergeFactor <= numSegments; ++first) {
+        int firstTier = tier(segments[first]);
+        bool sameTier = true;
+        for (int s = first; s < first + options.mergeFactor && sameTier; ++s) {
+            sameTier = isIncremental(segments[s]) && tier(segments[s]) == firstTier;
+        }
+        if (sameTier && (best < 0 || firstTier < bestTier)) {
+            best = first;
+            bestTier = firstTier;
+        }
+    }
+    return best;
+}
+
+std::string SegmentManager::newSegmentDirectory() {
+    std::string directory = SEGMENT_PREFIX + std::to_string(nextSegment++) + "/";
+    mkdir(directory.c_str(), 0755);
+    return directory;
+}
+
+void SegmentManager::removeRetired(bool all) {
+    auto now = std::chrono::steady_clock::now();
+    auto it = retired.begin();
+    while (it != retired.end()) {
+        if (!all && now - it->second < std::chrono::milliseconds(options.retireDelayMs)) {
+            ++it;
+            continue;
+        }
+        for (const char* file : SEGMENT_FILES) {
+            std::remove((it->first + file).c_str());
+        }
+        rmdir(it->first.c_str());
+        it = retired.erase(it);
+    }
+}
+
+void SegmentManager::runMerges() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        removeRetired(false);
+        int first = findMerge();
+        if (first < 0) {
+            if (stopping) {
+                break;
+            }
+            changed.wait_for(lock, std::chrono::seconds(1));
+            continue;
+        }
+
+        // Flushes only append, so the inputs stay at the same positions while merging
+        std::vector<ShardInfo> inputs(segments.begin() + first, segments.begin() + first + options.mergeFactor);
+        std::string directory = newSegmentDirectory();
+        lock.unlock();
+        std::vector<std::vector<int>> docIDMaps;
+        bool merged = mergeSegments(inputs, directory, docIDMaps);
+
+        // Deletions are blocked from here until the manifest lists the merged segment
+        ManifestLock manifestLock;
+        lock.lock();
+        ShardInfo output = { directory, inputs.front().docIDBase, 0 };
+        for (const std::vector<int>& docIDMap : docIDMaps) {
+            output.numDocs += static_cast<int>(std::count_if(docIDMap.begin(), docIDMap.end(), [](int id) { return id >= 0; }));
+        }
+        if (!merged || !carryDeletions(inputs, docIDMaps, output)) {
+            std::cerr << "Error: Merging segments into " << directory << " failed; merging stopped" << std::endl;
+            retired.emplace_back(directory, std::chrono::steady_clock::now());
+            break;
+        }
+
+        // The merged segment keeps the first input's docID base; dropped deletions leave a
+        // gap before the next segment, which the query processor does not mind
+        for (const ShardInfo& input : inputs) {
+            retired.emplace_back(input.directory, std::chrono::steady_clock::now());
+        }
+        segments.erase(segments.begin() + first, segments.begin() + first + options.mergeFactor);
+        segments.insert(segments.begin() + first, output);
+        writeShardManifest(SHARD_MANIFEST_FILE, segments);
+        std::cout << "[INFO] Merged " << inputs.size() << " segments (" << output.numDocs << " documents) into "
+                  << directory << std::endl;
+    }
+}
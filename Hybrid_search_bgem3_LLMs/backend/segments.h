@@ -0,0 +1,104 @@
+#ifndef SEGMENTS_H
+#define SEGMENTS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "shards.h"
+#include "doc_metadata.h"
+#include "tokenizer.h"
+
+// Incremental indexing. New documents are indexed in memory and flushed as small immutable
+// segments: directories in the same format as a shard (index, lexicon, document metadata
+// and document store) holding the next contiguous range of docIDs. Segments are added to
+// the shard manifest, so the query processor searches them together with the existing
+// index. A background thread merges runs of adjacent segments of similar size, keeping
+// the number of segments logarithmic in the number of documents.
+
+struct SegmentOptions {
+    // Flush the in-memory segment after this many documents...
+    int flushDocs = 1000;
+    // ...or when its oldest document has waited this long
+    int flushIntervalMs = 2000;
+    // Merge this many adjacent segments of the same size tier into one
+    int mergeFactor = 4;
+    // Keep merged-away segment directories this long for queries that already read the
+    // old manifest
+    int retireDelayMs = 30000;
+};
+
+// In-memory segment: postings, metadata and passages of the documents added since the
+// last flush. Local docIDs start at 0.
+class SegmentBuilder {
+public:
+    // Documents are tokenized with the analysis the rest of the index was built with
+    explicit SegmentBuilder(const TextAnalysis& analysis = TextAnalysis());
+
+    // offset is the document's byte offset in its source file
+    void addDocument(std::string_view passageID, std::string_view text, std::uint64_t offset);
+    int numDocs() const { return static_cast<int>(passages.size()); }
+    // Write the segment files into directory and start an empty segment
+    bool write(const std::string& directory);
+
+private:
+    Tokenizer tokenizer;
+    std::string analysis;
+    std::unordered_map<std::string, std::vector<std::pair<int, int>>> postings;
+    DocMetadataBuilder metadata;
+    std::vector<std::string> passages;
+};
+
+// Merge adjacent segments, in docID order, into one segment written to directory. Deleted
+// documents are dropped and the rest renumbered consecutively; docIDMaps[s][d] is the new
+// docID of document d of segment s, or -1 if it was dropped.
+bool mergeSegments(const std::vector<ShardInfo>& segments, const std::string& directory,
+                   std::vector<std::vector<int>>& docIDMaps);
+
+// Owns the shard manifest while documents are being added: appends flushed segments and
+// merges them in the background with a tiered policy. Only directories it created
+// (tmp/segment_N/) are ever merged or removed; a parser-built index or its shards stay
+// as they are at the front of the manifest.
+class SegmentManager {
+public:
+    explicit SegmentManager(const SegmentOptions& options);
+    ~SegmentManager();
+
+    // Load the manifest, creating one for an existing unsharded index, and start merging
+    bool open();
+    // Global docID the next added document will get
+    int nextDocID();
+    // Stemming and stopwords of the existing index, which added documents must go through too
+    const TextAnalysis& textAnalysis() const { return analysis; }
+    // Write the builder's documents as a new segment and publish it in the manifest
+    bool flush(SegmentBuilder& builder);
+    // Finish pending merges, remove retired segments and stop the merge thread
+    void close();
+
+private:
+    SegmentOptions options;
+    TextAnalysis analysis;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<ShardInfo> segments;
+    int nextSegment;
+    bool stopping;
+    std::thread mergeThread;
+    std::vector<std::pair<std::string, std::chrono::steady_clock::time_point>> retired;
+
+    static bool isIncremental(const ShardInfo& segment);
+    int tier(const ShardInfo& segment) const;
+    // First index of mergeFactor adjacent incremental segments in one tier, or -1
+    int findMerge() const;
+    std::string newSegmentDirectory();
+    void removeRetired(bool all);
+    void runMerges();
+};
+
+#endif // SEGMENTS_H
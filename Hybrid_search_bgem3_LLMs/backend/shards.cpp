@@ -0,0 +1,73 @@
+#include "shards.h"
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+std::string shardDirectory(int shard) {
+    std::string directory = "tmp/shard_" + std::to_string(shard) + "/";
+    mkdir(directory.c_str(), 0755);
+    return directory;
+}
+
+bool writeShardManifest(const std::string& manifestFile, const std::vector<ShardInfo>& shards) {
+    // Write a new file and rename it over the old one, so concurrent readers see either
+    // the old or the new manifest but never a partial one
+    std::string tempFile = manifestFile + ".tmp";
+    std::ofstream outFile(tempFile);
+    if (!outFile.is_open()) {
+        std::cerr << "Error: Unable to open file for writing: " << tempFile << std::endl;
+        return false;
+    }
+    outFile << shards.size() << "\n";
+    for (const ShardInfo& shard : shards) {
+        outFile << shard.directory << " " << shard.docIDBase << " " << shard.numDocs << "\n";
+    }
+    outFile.close();
+    if (!outFile.good() || std::rename(tempFile.c_str(), manifestFile.c_str()) != 0) {
+        std::cerr << "Error: Unable to write shard manifest: " << manifestFile << std::endl;
+        std::remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool readShardManifest(const std::string& manifestFile, std::vector<ShardInfo>& shards) {
+    std::ifstream inFile(manifestFile);
+    if (!inFile.is_open()) {
+        return false;
+    }
+    size_t numShards = 0;
+    inFile >> numShards;
+    shards.clear();
+    ShardInfo shard;
+    while (shards.size() < numShards && inFile >> shard.directory >> shard.docIDBase >> shard.numDocs) {
+        shards.push_back(shard);
+    }
+    if (shards.size() != numShards) {
+        std::cerr << "Error: Incomplete shard manifest: " << manifestFile << std::endl;
+        return false;
+    }
+    return true;
+}
+
+ManifestLock::ManifestLock(const std::string& manifestFile) {
+    fd = ::open((manifestFile + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || flock(fd, LOCK_EX) != 0) {
+        std::cerr << "Error: Unable to lock " << manifestFile << std::endl;
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+}
+
+ManifestLock::~ManifestLock() {
+    if (fd >= 0) {
+        flock(fd, LOCK_UN);
+        ::close(fd);
+    }
+}
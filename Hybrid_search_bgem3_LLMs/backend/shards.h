@@ -0,0 +1,44 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include <string>
+#include <vector>
+
+// A document-partitioned build splits the collection into contiguous docID ranges. Each
+// shard lives in its own directory with an independent index, lexicon, document metadata
+// and document store, and numbers its documents from 0. The manifest lists the shards and
+// the global docID of each shard's first document; it only exists for sharded builds and
+// for indexes extended with incremental segments (see segments.h), which are listed the
+// same way.
+const std::string SHARD_MANIFEST_FILE = "tmp/shards.txt";
+
+struct ShardInfo {
+    std::string directory;   // With a trailing slash, e.g. "tmp/shard_0/"
+    int docIDBase;           // Global docID of the shard's document 0
+    int numDocs;
+};
+
+// Directory of shard number shard; created if it does not exist
+std::string shardDirectory(int shard);
+
+bool writeShardManifest(const std::string& manifestFile, const std::vector<ShardInfo>& shards);
+// Returns false if the manifest does not exist or cannot be read
+bool readShardManifest(const std::string& manifestFile, std::vector<ShardInfo>& shards);
+
+// Exclusive advisory lock on the manifest, held while changing the set of index directories
+// or their deleted documents, so the indexer's merges and the deleter do not lose each
+// other's updates. Blocks until the lock is available; released on destruction.
+class ManifestLock {
+public:
+    explicit ManifestLock(const std::string& manifestFile = SHARD_MANIFEST_FILE);
+    ~ManifestLock();
+    ManifestLock(const ManifestLock&) = delete;
+    ManifestLock& operator=(const ManifestLock&) = delete;
+
+    bool locked() const { return fd >= 0; }
+
+private:
+    int fd;
+};
+
+#endif // SHARDS_H
@@ -0,0 +1,121 @@
+#include "snippet.h"
+#include <algorithm>
+
+SnippetGenerator::SnippetGenerator(const std::vector<std::string>& queryTerms, const TextAnalysis& analysis,
+                                   int windowTokens, int maxWindows)
+    : windowTokens(std::max(1, windowTokens)), maxWindows(std::max(1, maxWindows)), analysis(analysis) {
+    for (const std::string& term : queryTerms) {
+        if (std::find(this->queryTerms.begin(), this->queryTerms.end(), term) == this->queryTerms.end()) {
+            this->queryTerms.push_back(term);
+        }
+    }
+}
+
+Snippet SnippetGenerator::generate(const std::string& passage) {
+    Snippet snippet;
+    if (passage.empty()) {
+        return snippet;
+    }
+
+    // Tokenize a lower-cased copy; token offsets in the copy are offsets in the passage
+    buffer = passage;
+    const std::vector<std::string_view>& tokens = tokenizer.tokenizeInPlace(&buffer[0], buffer.size());
+    int numTokens = static_cast<int>(tokens.size());
+    if (numTokens == 0) {
+        snippet.text = passage;
+        return snippet;
+    }
+
+    // Which query term, if any, each token matches
+    std::vector<int> tokenTerms(numTokens, -1);
+    for (int i = 0; i < numTokens; ++i) {
+        std::string_view term = tokens[i];
+        if (analysis.enabled()) {
+            analyzedToken.assign(term.data(), term.size());
+            term = std::string_view(analyzedToken.data(), analysis.apply(&analyzedToken[0], analyzedToken.size()));
+        }
+        for (size_t t = 0; t < queryTerms.size(); ++t) {
+            if (!term.empty() && term == queryTerms[t]) {
+                tokenTerms[i] = static_cast<int>(t);
+                break;
+            }
+        }
+    }
+
+    // Slide a window over the tokens, scoring distinct terms first and hits second
+    int window = std::min(windowTokens, numTokens);
+    int numStarts = numTokens - window + 1;
+    std::vector<int> scores(numStarts);
+    std::vector<int> termCounts(queryTerms.size(), 0);
+    int distinctTerms = 0;
+    int hits = 0;
+    for (int i = 0; i < numTokens; ++i) {
+        if (tokenTerms[i] >= 0) {
+            hits++;
+            if (termCounts[tokenTerms[i]]++ == 0) {
+                distinctTerms++;
+            }
+        }
+        int leaving = i - window;
+        if (leaving >= 0 && tokenTerms[leaving] >= 0) {
+            hits--;
+            if (--termCounts[tokenTerms[leaving]] == 0) {
+                distinctTerms--;
+            }
+        }
+        if (i >= window - 1) {
+            scores[i - window + 1] = distinctTerms * (window + 1) + hits;
+        }
+    }
+
+    // Greedily keep the best non-overlapping windows; the first one is kept even without hits
+    std::vector<int> starts;
+    for (int w = 0; w < maxWindows; ++w) {
+        int best = -1;
+        for (int s = 0; s < numStarts; ++s) {
+            bool overlaps = false;
+            for (int chosen : starts) {
+                if (s < chosen + window && chosen < s + window) {
+                    overlaps = true;
+                    break;
+                }
+            }
+            if (!overlaps && (best < 0 || scores[s] > scores[best])) {
+                best = s;
+            }
+        }
+        if (best < 0 || (!starts.empty() && scores[best] == 0)) {
+            break;
+        }
+        starts.push_back(best);
+    }
+    std::sort(starts.begin(), starts.end());
+
+    // Copy each window from the original passage and record highlight offsets in the snippet
+    for (size_t w = 0; w < starts.size(); ++w) {
+        int first = starts[w];
+        int last = first + window;
+        size_t byteStart = first == 0 ? 0 : tokens[first].data() - buffer.data();
+        size_t byteEnd = last == numTokens ? passage.size() : tokens[last - 1].data() + tokens[last - 1].size() - buffer.data();
+
+        if (first > 0) {
+            snippet.text += w == 0 ? "... " : " ... ";
+        } else if (w > 0) {
+            snippet.text += " ";
+        }
+        size_t textStart = snippet.text.size();
+        snippet.text.append(passage, byteStart, byteEnd - byteStart);
+
+        for (int i = first; i < last; ++i) {
+            if (tokenTerms[i] >= 0) {
+                size_t tokenStart = tokens[i].data() - buffer.data();
+                snippet.highlights.emplace_back(static_cast<int>(textStart + tokenStart - byteStart),
+                                                static_cast<int>(tokens[i].size()));
+            }
+        }
+    }
+    if (starts.back() + window < numTokens) {
+        snippet.text += " ...";
+    }
+    return snippet;
+}
@@ -0,0 +1,38 @@
+#ifndef SNIPPET_H
+#define SNIPPET_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "tokenizer.h"
+
+// A passage excerpt and the byte ranges (start, length) of query terms within it
+struct Snippet {
+    std::string text;
+    std::vector<std::pair<int, int>> highlights;
+};
+
+// Builds result snippets with the same tokenizer the index uses, so highlighted words are
+// exactly the ones that matched. Windows are counted in plain tokens and a word is
+// highlighted whole when its analyzed form (see text_analysis.h) is a query term. Each candidate window of windowTokens tokens is scored by
+// the distinct query terms it contains, then by its total query-term hits; up to
+// maxWindows non-overlapping windows are kept and joined with "...".
+class SnippetGenerator {
+public:
+    // queryTerms are analyzed terms, and analysis is the one the index was built with
+    SnippetGenerator(const std::vector<std::string>& queryTerms, const TextAnalysis& analysis = TextAnalysis(),
+                     int windowTokens = 20, int maxWindows = 2);
+
+    Snippet generate(const std::string& passage);
+
+private:
+    std::vector<std::string> queryTerms;
+    int windowTokens;
+    int maxWindows;
+    TextAnalysis analysis;
+    Tokenizer tokenizer;
+    std::string buffer;
+    std::string analyzedToken;
+};
+
+#endif // SNIPPET_H
@@ -0,0 +1,370 @@
+#include "text_analysis.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char* const ENGLISH_STOPWORDS[] = {
+    "a", "an", "and", "are", "as", "at", "be", "but", "by", "for", "if", "in", "into", "is", "it", "no", "not",
+    "of", "on", "or", "such", "that", "the", "their", "then", "there", "these", "they", "this", "to", "was",
+    "will", "with",
+};
+
+// One pass of the stemmer over b[0..k]; j marks the end of the stem while suffixes are tested
+struct PorterStemmer {
+    char* b;
+    int k;
+    int j;
+
+    bool consonant(int i) const {
+        switch (b[i]) {
+        case 'a': case 'e': case 'i': case 'o': case 'u':
+            return false;
+        case 'y':
+            return i == 0 ? true : !consonant(i - 1);
+        default:
+            return true;
+        }
+    }
+
+    // Number of vowel-consonant sequences in b[0..j]
+    int measure() const {
+        int n = 0;
+        int i = 0;
+        while (true) {
+            if (i > j) {
+                return n;
+            }
+            if (!consonant(i)) {
+                break;
+            }
+            i++;
+        }
+        i++;
+        while (true) {
+            while (true) {
+                if (i > j) {
+                    return n;
+                }
+                if (consonant(i)) {
+                    break;
+                }
+                i++;
+            }
+            i++;
+            n++;
+            while (true) {
+                if (i > j) {
+                    return n;
+                }
+                if (!consonant(i)) {
+                    break;
+                }
+                i++;
+            }
+            i++;
+        }
+    }
+
+    bool vowelInStem() const {
+        for (int i = 0; i <= j; ++i) {
+            if (!consonant(i)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool doubleConsonant(int i) const {
+        return i >= 1 && b[i] == b[i - 1] && consonant(i);
+    }
+
+    // Consonant-vowel-consonant ending at i, where the last consonant is not w, x or y
+    bool cvc(int i) const {
+        if (i < 2 || !consonant(i) || consonant(i - 1) || !consonant(i - 2)) {
+            return false;
+        }
+        return b[i] != 'w' && b[i] != 'x' && b[i] != 'y';
+    }
+
+    bool ends(const char* suffix) {
+        int length = static_cast<int>(std::strlen(suffix));
+        if (length > k + 1 || suffix[length - 1] != b[k] || std::memcmp(b + k - length + 1, suffix, length) != 0) {
+            return false;
+        }
+        j = k - length;
+        return true;
+    }
+
+    void setTo(const char* suffix) {
+        int length = static_cast<int>(std::strlen(suffix));
+        std::memcpy(b + j + 1, suffix, length);
+        k = j + length;
+    }
+
+    void replace(const char* suffix) {
+        if (measure() > 0) {
+            setTo(suffix);
+        }
+    }
+
+    // Plurals and -ed or -ing
+    void step1ab() {
+        if (b[k] == 's') {
+            if (ends("sses")) {
+                k -= 2;
+            } else if (ends("ies")) {
+                setTo("i");
+            } else if (b[k - 1] != 's') {
+                k--;
+            }
+        }
+        if (ends("eed")) {
+            if (measure() > 0) {
+                k--;
+            }
+        } else if ((ends("ed") || ends("ing")) && vowelInStem()) {
+            k = j;
+            if (ends("at")) {
+                setTo("ate");
+            } else if (ends("bl")) {
+                setTo("ble");
+            } else if (ends("iz")) {
+                setTo("ize");
+            } else if (doubleConsonant(k)) {
+                k--;
+                if (b[k] == 'l' || b[k] == 's' || b[k] == 'z') {
+                    k++;
+                }
+            } else if (measure() == 1 && cvc(k)) {
+                setTo("e");
+            }
+        }
+    }
+
+    // Terminal y to i when there is another vowel in the stem
+    void step1c() {
+        if (ends("y") && vowelInStem()) {
+            b[k] = 'i';
+        }
+    }
+
+    // Try the (suffix, replacement) pairs in order; the first suffix that matches ends the
+    // step whether or not the stem is long enough to replace it
+    void replaceFirst(const char* const* pairs, int numPairs) {
+        for (int i = 0; i < numPairs; ++i) {
+            if (ends(pairs[2 * i])) {
+                replace(pairs[2 * i + 1]);
+                return;
+            }
+        }
+    }
+
+    // Double suffixes to single ones
+    void step2() {
+        static const char* const A[] = {"ational", "ate", "tional", "tion"};
+        static const char* const C[] = {"enci", "ence", "anci", "ance"};
+        static const char* const E[] = {"izer", "ize"};
+        static const char* const L[] = {"bli", "ble", "alli", "al", "entli", "ent", "eli", "e", "ousli", "ous"};
+        static const char* const O[] = {"ization", "ize", "ation", "ate", "ator", "ate"};
+        static const char* const S[] = {"alism", "al", "iveness", "ive", "fulness", "ful", "ousness", "ous"};
+        static const char* const T[] = {"aliti", "al", "iviti", "ive", "biliti", "ble"};
+        static const char* const G[] = {"logi", "log"};
+        switch (b[k - 1]) {
+        case 'a': replaceFirst(A, 2); break;
+        case 'c': replaceFirst(C, 2); break;
+        case 'e': replaceFirst(E, 1); break;
+        case 'l': replaceFirst(L, 5); break;
+        case 'o': replaceFirst(O, 3); break;
+        case 's': replaceFirst(S, 4); break;
+        case 't': replaceFirst(T, 3); break;
+        case 'g': replaceFirst(G, 1); break;
+        }
+    }
+
+    // -ic-, -full, -ness etc.
+    void step3() {
+        static const char* const E[] = {"icate", "ic", "ative", "", "alize", "al"};
+        static const char* const I[] = {"iciti", "ic"};
+        static const char* const L[] = {"ical", "ic", "ful", ""};
+        static const char* const S[] = {"ness", ""};
+        switch (b[k]) {
+        case 'e': replaceFirst(E, 3); break;
+        case 'i': replaceFirst(I, 1); break;
+        case 'l': replaceFirst(L, 2); break;
+        case 's': replaceFirst(S, 1); break;
+        }
+    }
+
+    // -ant, -ence etc. in a stem with more than one vowel-consonant sequence
+    void step4() {
+        bool found = false;
+        switch (b[k - 1]) {
+        case 'a': found = ends("al"); break;
+        case 'c': found = ends("ance") || ends("ence"); break;
+        case 'e': found = ends("er"); break;
+        case 'i': found = ends("ic"); break;
+        case 'l': found = ends("able") || ends("ible"); break;
+        case 'n': found = ends("ant") || ends("ement") || ends("ment") || ends("ent"); break;
+        case 'o': found = (ends("ion") && j >= 0 && (b[j] == 's' || b[j] == 't')) || ends("ou"); break;
+        case 's': found = ends("ism"); break;
+        case 't': found = ends("ate") || ends("iti"); break;
+        case 'u': found = ends("ous"); break;
+        case 'v': found = ends("ive"); break;
+        case 'z': found = ends("ize"); break;
+        }
+        if (found && measure() > 1) {
+            k = j;
+        }
+    }
+
+    // Final -e, and -ll to -l
+    void step5() {
+        j = k;
+        if (b[k] == 'e') {
+            int m = measure();
+            if (m > 1 || (m == 1 && !cvc(k - 1))) {
+                k--;
+            }
+        }
+        if (b[k] == 'l' && doubleConsonant(k) && measure() > 1) {
+            k--;
+        }
+    }
+};
+
+} // namespace
+
+size_t porterStem(char* word, size_t length) {
+    // Words of one or two letters are left alone
+    if (length <= 2) {
+        return length;
+    }
+    PorterStemmer stemmer{word, static_cast<int>(length) - 1, 0};
+    stemmer.step1ab();
+    if (stemmer.k > 0) {
+        stemmer.step1c();
+        stemmer.step2();
+        stemmer.step3();
+        stemmer.step4();
+        stemmer.step5();
+    }
+    return static_cast<size_t>(stemmer.k + 1);
+}
+
+bool TextAnalysis::isStopword(std::string_view token) const {
+    auto it = std::lower_bound(stopwords.begin(), stopwords.end(), token,
+                               [](const std::string& word, std::string_view key) { return std::string_view(word) < key; });
+    return it != stopwords.end() && std::string_view(*it) == token;
+}
+
+size_t TextAnalysis::apply(char* token, size_t length) const {
+    if (!stopwords.empty() && isStopword(std::string_view(token, length))) {
+        return 0;
+    }
+    if (!stem) {
+        return length;
+    }
+    // Numbers and alphanumeric codes are kept as they are
+    for (size_t i = 0; i < length; ++i) {
+        if (token[i] < 'a' || token[i] > 'z') {
+            return length;
+        }
+    }
+    return porterStem(token, length);
+}
+
+std::string TextAnalysis::describe() const {
+    if (!enabled()) {
+        return std::string();
+    }
+    std::string description = stem ? "stem=porter;stopwords=" : "stem=none;stopwords=";
+    for (size_t i = 0; i < stopwords.size(); ++i) {
+        if (i > 0) {
+            description += ',';
+        }
+        description += stopwords[i];
+    }
+    return description;
+}
+
+bool TextAnalysis::fromDescription(std::string_view description, TextAnalysis& analysis) {
+    analysis = TextAnalysis();
+    if (description.empty()) {
+        return true;
+    }
+    const std::string_view STOPWORDS_PREFIX = ";stopwords=";
+    size_t separator = description.find(';');
+    if (separator == std::string_view::npos || description.substr(separator, STOPWORDS_PREFIX.size()) != STOPWORDS_PREFIX) {
+        return false;
+    }
+    std::string_view stemmer = description.substr(0, separator);
+    if (stemmer == "stem=porter") {
+        analysis.stem = true;
+    } else if (stemmer != "stem=none") {
+        return false;
+    }
+    std::string_view words = description.substr(separator + STOPWORDS_PREFIX.size());
+    while (!words.empty()) {
+        size_t comma = words.find(',');
+        analysis.stopwords.emplace_back(words.substr(0, comma));
+        words = comma == std::string_view::npos ? std::string_view() : words.substr(comma + 1);
+    }
+    return std::is_sorted(analysis.stopwords.begin(), analysis.stopwords.end());
+}
+
+std::string TextAnalysis::summary() const {
+    if (!enabled()) {
+        return "no stemming or stopwords";
+    }
+    std::string text = stem ? "porter stemming" : "no stemming";
+    return text + ", " + std::to_string(stopwords.size()) + " stopwords";
+}
+
+bool operator==(const TextAnalysis& a, const TextAnalysis& b) {
+    return a.stem == b.stem && a.stopwords == b.stopwords;
+}
+
+bool loadStopwords(const std::string& policy, TextAnalysis& analysis) {
+    analysis.stopwords.clear();
+    if (policy == "none") {
+        return true;
+    }
+    if (policy == "english") {
+        analysis.stopwords.assign(std::begin(ENGLISH_STOPWORDS), std::end(ENGLISH_STOPWORDS));
+    } else {
+        std::ifstream inFile(policy);
+        if (!inFile.is_open()) {
+            std::cerr << "Error opening stopword file: " << policy << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(inFile, line)) {
+            line = line.substr(0, line.find('#'));
+            size_t begin = line.find_first_not_of(" \t\r");
+            if (begin == std::string::npos) {
+                continue;
+            }
+            std::string word = line.substr(begin, line.find_last_not_of(" \t\r") + 1 - begin);
+            // Only a single lower-case token can ever match
+            bool valid = true;
+            for (char& c : word) {
+                if (c >= 'A' && c <= 'Z') {
+                    c = static_cast<char>(c + 32);
+                } else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))) {
+                    valid = false;
+                }
+            }
+            if (!valid) {
+                std::cerr << "Warning: Ignoring stopword that is not a single token: " << word << std::endl;
+                continue;
+            }
+            analysis.stopwords.push_back(word);
+        }
+    }
+    std::sort(analysis.stopwords.begin(), analysis.stopwords.end());
+    analysis.stopwords.erase(std::unique(analysis.stopwords.begin(), analysis.stopwords.end()), analysis.stopwords.end());
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef TEXT_ANALYSIS_H
+#define TEXT_ANALYSIS_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+// Optional normalization of tokens after the tokenizer has split and lower-cased them:
+// stopwords are dropped, then the remaining purely alphabetic tokens are reduced to their
+// Porter stem. Both steps work on the token's bytes in place and never allocate.
+//
+// The index and the queries must be analyzed alike, so the parser records the analysis in
+// the document metadata (see doc_metadata.h) and the query processor refuses an index whose
+// analysis differs from its own.
+struct TextAnalysis {
+    bool stem = false;
+    // Sorted and unique, lower-case
+    std::vector<std::string> stopwords;
+
+    bool enabled() const { return stem || !stopwords.empty(); }
+    bool isStopword(std::string_view token) const;
+    // Analyze a lower-case token in place; returns its new length, or 0 if it is dropped
+    size_t apply(char* token, size_t length) const;
+
+    // Canonical form stored in the metadata; empty when nothing is enabled
+    std::string describe() const;
+    // Inverse of describe(); returns false if the description is malformed
+    static bool fromDescription(std::string_view description, TextAnalysis& analysis);
+    // Short human-readable form for messages, e.g. "porter stemming, 33 stopwords"
+    std::string summary() const;
+};
+
+bool operator==(const TextAnalysis& a, const TextAnalysis& b);
+inline bool operator!=(const TextAnalysis& a, const TextAnalysis& b) { return !(a == b); }
+
+// Set the stopword policy from a --stopwords value: none, english (the classic 33-word
+// English list) or the path of a file with one word per line, '#' starting a comment.
+// Returns false if the file cannot be read.
+bool loadStopwords(const std::string& policy, TextAnalysis& analysis);
+
+// Porter stemmer (M. F. Porter, 1980, as in his reference C implementation). Rewrites a
+// lower-case ASCII word in place and returns its new length, which is never longer.
+size_t porterStem(char* word, size_t length);
+
+#endif // TEXT_ANALYSIS_H
@@ -0,0 +1,218 @@
+#include "tokenizer.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TOKENIZER_X86 1
+#endif
+
+namespace {
+
+// Byte classes
+const std::uint8_t CLASS_DELIMITER = 1; // isspace or ispunct in the C locale
+const std::uint8_t CLASS_UPPER = 2;     // 'A'..'Z'
+const std::uint8_t CLASS_HIGH = 4;      // Non-ASCII byte
+
+struct ByteClassTable {
+    std::uint8_t classes[256];
+
+    ByteClassTable() {
+        for (int c = 0; c < 256; ++c) {
+            std::uint8_t cls = 0;
+            if ((c >= 9 && c <= 13) || (c >= 32 && c <= 47) || (c >= 58 && c <= 64) || (c >= 91 && c <= 96) ||
+                (c >= 123 && c <= 126)) {
+                cls |= CLASS_DELIMITER;
+            }
+            if (c >= 'A' && c <= 'Z') {
+                cls |= CLASS_UPPER;
+            }
+            if (c >= 128) {
+                cls |= CLASS_HIGH;
+            }
+            classes[c] = cls;
+        }
+    }
+};
+
+const ByteClassTable byteClassTable;
+
+// Classify 64 bytes, lower-casing them in place; bit i of the masks describes byte i
+typedef void (*ClassifyBlockFn)(char* data, std::uint64_t& delimiters, std::uint64_t& high);
+
+#ifdef TOKENIZER_X86
+
+// Signed byte range test lo <= c <= hi; bytes >= 0x80 are negative and never match
+inline __m128i inRange128(__m128i c, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8(hi + 1)));
+}
+
+void classifyBlockSSE2(char* data, std::uint64_t& delimiters, std::uint64_t& high) {
+    delimiters = 0;
+    high = 0;
+    for (int i = 0; i < 64; i += 16) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i delimiter = _mm_or_si128(
+            _mm_or_si128(inRange128(c, 9, 13), inRange128(c, 32, 47)),
+            _mm_or_si128(_mm_or_si128(inRange128(c, 58, 64), inRange128(c, 91, 96)), inRange128(c, 123, 126)));
+        __m128i upper = inRange128(c, 'A', 'Z');
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i),
+                         _mm_add_epi8(c, _mm_and_si128(upper, _mm_set1_epi8(32))));
+        delimiters |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm_movemask_epi8(delimiter))) << i;
+        high |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm_movemask_epi8(c))) << i;
+    }
+}
+
+__attribute__((target("avx2")))
+inline __m256i inRange256(__m256i c, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), c));
+}
+
+__attribute__((target("avx2")))
+void classifyBlockAVX2(char* data, std::uint64_t& delimiters, std::uint64_t& high) {
+    delimiters = 0;
+    high = 0;
+    for (int i = 0; i < 64; i += 32) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i delimiter = _mm256_or_si256(
+            _mm256_or_si256(inRange256(c, 9, 13), inRange256(c, 32, 47)),
+            _mm256_or_si256(_mm256_or_si256(inRange256(c, 58, 64), inRange256(c, 91, 96)), inRange256(c, 123, 126)));
+        __m256i upper = inRange256(c, 'A', 'Z');
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i),
+                            _mm256_add_epi8(c, _mm256_and_si256(upper, _mm256_set1_epi8(32))));
+        delimiters |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(delimiter))) << i;
+        high |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(c))) << i;
+    }
+}
+
+ClassifyBlockFn selectClassifyBlock() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return classifyBlockAVX2;
+    }
+    return classifyBlockSSE2;
+}
+
+#else
+
+void classifyBlockScalar(char* data, std::uint64_t& delimiters, std::uint64_t& high) {
+    delimiters = 0;
+    high = 0;
+    for (int i = 0; i < 64; ++i) {
+        std::uint8_t cls = byteClassTable.classes[static_cast<unsigned char>(data[i])];
+        if (cls & CLASS_UPPER) {
+            data[i] = static_cast<char>(data[i] + 32);
+        }
+        delimiters |= static_cast<std::uint64_t>(cls & CLASS_DELIMITER) << i;
+        high |= static_cast<std::uint64_t>((cls & CLASS_HIGH) >> 2) << i;
+    }
+}
+
+ClassifyBlockFn selectClassifyBlock() {
+    return classifyBlockScalar;
+}
+
+#endif
+
+const ClassifyBlockFn classifyBlock = selectClassifyBlock();
+
+// Bits [from, to) of a 64-bit mask
+inline std::uint64_t bitRange(int from, int to) {
+    std::uint64_t upTo = (to >= 64) ? ~0ULL : ((1ULL << to) - 1);
+    return upTo & ~((1ULL << from) - 1);
+}
+
+} // namespace
+
+Tokenizer::Tokenizer(const TextAnalysis& analysis) : analysis(analysis) {
+}
+
+const std::vector<std::string_view>& Tokenizer::tokenize(std::string_view text) {
+    buffer.assign(text.data(), text.size());
+    return tokenizeInPlace(&buffer[0], buffer.size());
+}
+
+const std::vector<std::string_view>& Tokenizer::tokenizeInPlace(char* data, size_t size) {
+    tokens.clear();
+
+    bool inToken = false;
+    bool tokenHigh = false;
+    size_t tokenStart = 0;
+    std::uint64_t previousDelimiter = 1; // Text start behaves like a delimiter
+
+    size_t base = 0;
+    for (; base + 64 <= size; base += 64) {
+        std::uint64_t delimiters;
+        std::uint64_t high;
+        classifyBlock(data + base, delimiters, high);
+
+        // Token starts are non-delimiters after a delimiter, ends are delimiters after a non-delimiter
+        std::uint64_t nonDelimiters = ~delimiters;
+        std::uint64_t starts = nonDelimiters & ((delimiters << 1) | previousDelimiter);
+        std::uint64_t ends = delimiters & ((nonDelimiters << 1) | (previousDelimiter ^ 1));
+        previousDelimiter = delimiters >> 63;
+
+        int pos = 0;
+        while (true) {
+            if (inToken) {
+                int end = ends ? __builtin_ctzll(ends) : 64;
+                tokenHigh |= (high & bitRange(pos, end)) != 0;
+                if (end == 64) {
+                    break;
+                }
+                if (!tokenHigh) {
+                    tokens.emplace_back(data + tokenStart, base + end - tokenStart);
+                }
+                inToken = false;
+                ends &= ends - 1;
+                pos = end;
+            } else {
+                if (!starts) {
+                    break;
+                }
+                int start = __builtin_ctzll(starts);
+                starts &= starts - 1;
+                inToken = true;
+                tokenHigh = false;
+                tokenStart = base + start;
+                pos = start;
+            }
+        }
+    }
+
+    // Tail shorter than a block
+    for (size_t i = base; i < size; ++i) {
+        std::uint8_t cls = byteClassTable.classes[static_cast<unsigned char>(data[i])];
+        if (cls & CLASS_DELIMITER) {
+            if (inToken && !tokenHigh) {
+                tokens.emplace_back(data + tokenStart, i - tokenStart);
+            }
+            inToken = false;
+            continue;
+        }
+        if (cls & CLASS_UPPER) {
+            data[i] = static_cast<char>(data[i] + 32);
+        }
+        if (!inToken) {
+            inToken = true;
+            tokenHigh = false;
+            tokenStart = i;
+        }
+        tokenHigh |= (cls & CLASS_HIGH) != 0;
+    }
+    if (inToken && !tokenHigh) {
+        tokens.emplace_back(data + tokenStart, size - tokenStart);
+    }
+
+    if (analysis.enabled()) {
+        size_t kept = 0;
+        for (std::string_view token : tokens) {
+            char* tokenData = const_cast<char*>(token.data());
+            size_t length = analysis.apply(tokenData, token.size());
+            if (length > 0) {
+                tokens[kept++] = std::string_view(tokenData, length);
+            }
+        }
+        tokens.resize(kept);
+    }
+    return tokens;
+}
@@ -0,0 +1,38 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include "text_analysis.h"
+
+// Shared tokenizer used at index time (parser) and query time (query processor), so both
+// sides see identical tokens. Punctuation and whitespace (C locale ispunct/isspace)
+// separate tokens, ASCII letters are lower-cased, and tokens containing non-ASCII bytes
+// are dropped.
+//
+// Bytes are classified 32 or 16 at a time with AVX2 or SSE2, selected at runtime, with a
+// lookup-table path for the tail and for other architectures. Tokens are returned as
+// views into the tokenized text and the token vector is reused across calls, so
+// tokenizing a document does not allocate.
+//
+// A tokenizer constructed with a TextAnalysis also drops stopwords and stems the tokens,
+// shortening them in place; the views then point at the analyzed bytes.
+class Tokenizer {
+public:
+    explicit Tokenizer(const TextAnalysis& analysis = TextAnalysis());
+
+    // Lower-case a mutable buffer in place and split it; the views point into data
+    const std::vector<std::string_view>& tokenizeInPlace(char* data, size_t size);
+
+    // Tokenize a copy of text held by the tokenizer; the views stay valid until the next call
+    const std::vector<std::string_view>& tokenize(std::string_view text);
+
+private:
+    TextAnalysis analysis;
+    std::string buffer;
+    std::vector<std::string_view> tokens;
+};
+
+#endif // TOKENIZER_H
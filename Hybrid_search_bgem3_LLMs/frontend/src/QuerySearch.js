@@ -8,7 +8,6 @@ const QuerySearch = () => {
   const [error, setError] = useState('');
   const [loading, setLoading] = useState(false);
   const [processingTime, setProcessingTime] = useState(null);
-  const [queryWords, setQueryWords] = useState('')
 
   const handleSearch = async () => {
     setError('');
@@ -29,12 +28,6 @@ const QuerySearch = () => {
       setResults(data.results);
       setProcessingTime(data.processing_time.toFixed(4));
       setLoading(false);
-      setQueryWords(data.expanded_query
-        .toLowerCase()
-        .split(/\s+/)
-        .map((word) => word.replace(/[^\w]/g, ''))
-        .filter((word) => word.length > 0))
-      
     } catch (err) {
       setLoading(false);
       setError('Could not connect to the backend. Please try again later.');
@@ -42,23 +35,24 @@ const QuerySearch = () => {
     }
   };
 
-  // Function to highlight query words in the snippet
-  const highlightSnippet = (snippet, query) => {
-    if (queryWords.length === 0) {
+  // Function to highlight query words in the snippet, using the [start, length]
+  // ranges computed by the query processor
+  const highlightSnippet = (snippet, highlights) => {
+    if (!highlights || highlights.length === 0) {
       return snippet;
     }
 
-    // Escape special characters in query words for regex
-    const escapedWords = queryWords.map((word) => word.replace(/[-/\\^$*+?.()|[\]{}]/g, '\\$&'));
-
-    // Create a regex pattern to match any of the query words, case-insensitive
-    const pattern = new RegExp(`\\b(${escapedWords.join('|')})\\b`, 'gi');
-
-    // Replace occurrences in the snippet with <strong> tags
-    const highlightedSnippet = snippet.replace(pattern, (match) => `<strong>${match}</strong>`);
-
-    // Render the highlighted snippet safely
-    return <span dangerouslySetInnerHTML={{ __html: highlightedSnippet }} />;
+    const parts = [];
+    let position = 0;
+    highlights.forEach(([start, length], index) => {
+      if (start > position) {
+        parts.push(snippet.slice(position, start));
+      }
+      parts.push(<strong key={index}>{snippet.slice(start, start + length)}</strong>);
+      position = start + length;
+    });
+    parts.push(snippet.slice(position));
+    return <span>{parts}</span>;
   };
 
   return (
@@ -96,7 +90,7 @@ const QuerySearch = () => {
               <strong>Score:</strong> {result.score}
             </p>
             <p className="snippet">
-              {highlightSnippet(result.snippet, query)}
+              {highlightSnippet(result.snippet, result.highlights)}
             </p>
           </div>
         ))}